@@ -0,0 +1,659 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+// Microbenchmarks for the text processing on the receive path of the IRC
+// protocol. They run over the lines in the corpus directory, and report
+// the time and the number of heap allocations per operation.
+//
+// Usage: bench [--corpus=<directory>] [google benchmark options]
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "IRC.hpp"
+#include "IRCFormatting.hpp"
+#include "IRCTags.hpp"
+#include "maskSet.hpp"
+#include "nearDuplicates.hpp"
+#include "triggerSet.hpp"
+#include "splitString.hpp"
+
+//----------------------------------------------------------------------------
+// Allocation counting
+//----------------------------------------------------------------------------
+static std::atomic<uint64_t> allocations = 0;
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+class AllocationCounter {
+  public:
+    explicit AllocationCounter(benchmark::State &state) : mState(state), mStart(allocations.load()) {}
+    ~AllocationCounter() {
+        mState.counters["allocs/op"] =
+            benchmark::Counter(double(allocations.load() - mStart) / mOperations, benchmark::Counter::kDefaults);
+        mState.SetItemsProcessed(mOperations);
+    }
+    void operation(void) { mOperations++; }
+
+  private:
+    benchmark::State &mState;
+    uint64_t mStart;
+    int64_t mOperations = 0;
+};
+
+//----------------------------------------------------------------------------
+// Corpus
+//----------------------------------------------------------------------------
+#ifndef BENCH_CORPUS_DIR
+#define BENCH_CORPUS_DIR "corpus"
+#endif
+static std::string corpusDirectory = BENCH_CORPUS_DIR;
+
+static const std::vector<std::string> &corpus(const std::string &name) {
+    static std::map<std::string, std::vector<std::string>> corpora;
+    auto &lines = corpora[name];
+    if (lines.empty()) {
+        std::ifstream file(corpusDirectory + "/" + name);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.length())
+                lines.push_back(line);
+        }
+        if (lines.empty()) {
+            fprintf(stderr, "Corpus %s/%s is missing or empty\n", corpusDirectory.c_str(), name.c_str());
+            exit(1);
+        }
+    }
+    return lines;
+}
+
+static const char *corpusNames[] = {"ircv3-tags.txt", "names.txt", "colours.txt", "utf8-nicks.txt"};
+
+//----------------------------------------------------------------------------
+// Access to the internals of the IRC class
+//----------------------------------------------------------------------------
+namespace geblaat {
+struct IRCBench {
+    using View = IRC::IRCMessageView;
+    using SourceView = IRC::IRCSourceView;
+
+    static bool parse(std::string_view line, View &view) { return IRC::parseMessageView(line, view); }
+    static IRC::IRCMessage toMessage(IRC &irc, const View &view) { return irc.toMessage(view); }
+    static void splitUserNickHost(SourceView &source) { IRC::splitUserNickHost(source); }
+    static std::string toLower(IRC &irc, std::string_view s) { return irc.toLower(s); }
+    static bool isEqual(IRC &irc, std::string_view first, std::string_view second) { return irc.isEqual(first, second); }
+    static IRC::IRCChannel &channel(IRC &irc, std::string_view name) { return irc.channel(name); }
+    static std::string stripFormatting(IRC &irc, std::string_view s) { return irc.stripFormatting(s); }
+    static std::map<std::string, std::string> messageToClient(IRC &irc, IRC::IRCMessage &message) {
+        return irc.messageToClient(message);
+    }
+    static void feed(IRC &irc, std::string_view line) {
+        View view;
+        if (parse(line, view))
+            irc.onMessage(view);
+    }
+    static void applyFeatures(IRC &irc) { irc.applyFeatures(); }
+    static void applyModes(IRC &irc, std::string_view channel, const std::pmr::vector<std::string> &parameters) {
+        irc.applyModes(irc.channel(channel), parameters, 1);
+    }
+    static void commitNames(IRC &irc, std::string_view name) {
+        auto symbol = irc.findSymbol(name);
+        irc.commitNames(symbol, irc.ircChannels[symbol]);
+    }
+    static void publish(IRC &irc) { irc.publish(); }
+    static void setFeature(IRC &irc, const std::string &key, const std::string &value) {
+        irc.serverInfo.features[key] = value;
+        irc.configureCaseMapping();
+    }
+};
+} // namespace geblaat
+
+using geblaat::IRC;
+using geblaat::IRCBench;
+
+// Parameters of the text carrying messages in the corpus
+static std::vector<std::string> texts(const std::string &name) {
+    std::vector<std::string> result;
+    for (auto &line : corpus(name)) {
+        IRCBench::View view;
+        if (IRCBench::parse(line, view) && view.parameterCount)
+            result.emplace_back(view.parameters[view.parameterCount - 1]);
+    }
+    return result;
+}
+
+//----------------------------------------------------------------------------
+// Benchmarks
+//----------------------------------------------------------------------------
+static void BM_ParseMessageView(benchmark::State &state, const char *name) {
+    auto &lines = corpus(name);
+    AllocationCounter counter(state);
+    IRCBench::View view;
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(IRCBench::parse(lines[i++ % lines.size()], view));
+        counter.operation();
+    }
+}
+
+static void BM_ParseMessage(benchmark::State &state, const char *name) {
+    auto &lines = corpus(name);
+    IRC irc;
+    AllocationCounter counter(state);
+    IRCBench::View view;
+    size_t i = 0;
+    for (auto _ : state) {
+        IRCBench::parse(lines[i++ % lines.size()], view);
+        auto message = IRCBench::toMessage(irc, view);
+        benchmark::DoNotOptimize(message);
+        counter.operation();
+    }
+}
+
+static void BM_ParseTags(benchmark::State &state) {
+    std::vector<std::string_view> tagStrings;
+    for (auto &line : corpus("ircv3-tags.txt")) {
+        IRCBench::View view;
+        if (IRCBench::parse(line, view))
+            tagStrings.push_back(view.tags);
+    }
+    geblaat::IRCTags tags;
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        tags.parse(tagStrings[i++ % tagStrings.size()]);
+        benchmark::DoNotOptimize(tags);
+        counter.operation();
+    }
+}
+
+static void BM_FormatTags(benchmark::State &state) {
+    std::map<std::string, std::string> tags = {
+        {"+draft/reply", "1mjlpuqiuxjzo2le6jp0u9oaw7"}, {"+typing", "active"}, {"label", "lbl 42;x"}};
+    std::string out;
+    out.reserve(512);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        out.clear();
+        geblaat::IRCTags::format(out, tags);
+        benchmark::DoNotOptimize(out);
+        counter.operation();
+    }
+}
+
+static void BM_SplitUserNickHost(benchmark::State &state) {
+    std::vector<IRCBench::SourceView> sources;
+    for (auto &name : corpusNames) {
+        for (auto &line : corpus(name)) {
+            IRCBench::View view;
+            if (IRCBench::parse(line, view) && view.source.raw.length())
+                sources.push_back(view.source);
+        }
+    }
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        auto source = sources[i++ % sources.size()];
+        IRCBench::splitUserNickHost(source);
+        benchmark::DoNotOptimize(source);
+        counter.operation();
+    }
+}
+
+// Nicks and targets found in the corpus
+static std::vector<std::string> identifiers(void) {
+    std::vector<std::string> identifiers;
+    for (auto &name : {"ircv3-tags.txt", "utf8-nicks.txt"}) {
+        for (auto &line : corpus(name)) {
+            IRCBench::View view;
+            if (IRCBench::parse(line, view) && view.source.nick.length()) {
+                identifiers.emplace_back(view.source.nick);
+                if (view.parameterCount)
+                    identifiers.emplace_back(view.parameters[0]);
+            }
+        }
+    }
+    return identifiers;
+}
+
+static void BM_ToLower(benchmark::State &state, const char *caseMapping) {
+    auto identifiers = ::identifiers();
+    IRC irc;
+    IRCBench::setFeature(irc, "CASEMAPPING", caseMapping);
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(IRCBench::toLower(irc, identifiers[i++ % identifiers.size()]));
+        counter.operation();
+    }
+}
+
+static void BM_ToLowerUtf8(benchmark::State &state) {
+    // Repeating identifiers hit the fold cache once it has warmed up
+    auto identifiers = ::identifiers();
+    IRC irc;
+    IRCBench::setFeature(irc, "CASEMAPPING", "rfc8265");
+    IRCBench::setFeature(irc, "UTF8MAPPING", "rfc8265");
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(IRCBench::toLower(irc, identifiers[i++ % identifiers.size()]));
+        counter.operation();
+    }
+}
+
+static void BM_FormattedText(benchmark::State &state, const char *name, const char *rendering) {
+    auto lines = texts(name);
+    std::string which = rendering;
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        geblaat::FormattedText text(lines[i++ % lines.size()]);
+        if (which == "plain")
+            benchmark::DoNotOptimize(text.plain());
+        else if (which == "ansi")
+            benchmark::DoNotOptimize(text.ansi());
+        else if (which == "html")
+            benchmark::DoNotOptimize(text.html());
+        counter.operation();
+    }
+}
+
+static void BM_SplitText(benchmark::State &state, const char *name) {
+    // Join the corpus into texts that take a few lines to send
+    std::vector<std::string> joined(1);
+    for (auto &line : texts(name)) {
+        joined.back() += line;
+        joined.back() += ' ';
+        if (joined.back().length() > 2000)
+            joined.emplace_back();
+    }
+    std::vector<std::string_view> lines;
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        lines.clear();
+        geblaat::IRCFormatting::split(joined[i++ % joined.size()], 400, lines);
+        benchmark::DoNotOptimize(lines.data());
+        counter.operation();
+    }
+}
+
+static void BM_IsEqual(benchmark::State &state, const char *caseMapping) {
+    // Compare every identifier with a case swapped copy of itself
+    auto identifiers = ::identifiers();
+    std::vector<std::string> swapped;
+    for (auto &identifier : identifiers) {
+        swapped.push_back(identifier);
+        for (auto &c : swapped.back())
+            c = isupper((unsigned char)c) ? tolower((unsigned char)c) : toupper((unsigned char)c);
+    }
+    IRC irc;
+    IRCBench::setFeature(irc, "CASEMAPPING", caseMapping);
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        size_t index = i++ % identifiers.size();
+        benchmark::DoNotOptimize(IRCBench::isEqual(irc, identifiers[index], swapped[index]));
+        counter.operation();
+    }
+}
+
+static void BM_ChannelLookup(benchmark::State &state) {
+    // Looks up channels by the name as it appears in messages
+    IRC irc;
+    IRCBench::setFeature(irc, "CASEMAPPING", "rfc1459");
+    std::vector<std::string> names;
+    for (unsigned i = 0; i < 1000; i++) {
+        names.push_back("#Channel[" + std::to_string(i) + "]");
+        IRCBench::channel(irc, names.back());
+    }
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(IRCBench::channel(irc, names[i++ % names.size()]));
+        counter.operation();
+    }
+}
+
+static void BM_UserChurn(benchmark::State &state) {
+    // A user quits and returns to its channels, which should not depend on
+    // the number of users or channels
+    IRC irc;
+    IRCBench::setFeature(irc, "CASEMAPPING", "rfc1459");
+    const unsigned users = state.range(0), channels = 2000, degree = 4;
+    std::vector<std::vector<std::string>> joins(users);
+    for (unsigned i = 0; i < users; i++) {
+        auto source = ":user" + std::to_string(i) + "!ident" + std::to_string(i) + "@host" + std::to_string(i % 5000) + ".example";
+        for (unsigned j = 0; j < degree; j++)
+            joins[i].push_back(source + " JOIN #channel" + std::to_string((i * 7 + j * 131) % channels));
+        for (auto &join : joins[i])
+            IRCBench::feed(irc, join);
+    }
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        auto &user = joins[i++ % users];
+        IRCBench::feed(irc, user[0].substr(0, user[0].find(' ')) + " QUIT :bye");
+        for (auto &join : user)
+            IRCBench::feed(irc, join);
+        counter.operation();
+    }
+}
+
+static void BM_NamesIngest(benchmark::State &state) {
+    // The NAMES replies for a channel we rejoin, with multi-prefix and
+    // userhost-in-names. An operation is the whole channel.
+    IRC irc;
+    IRCBench::setFeature(irc, "CASEMAPPING", "rfc1459");
+    IRCBench::setFeature(irc, "PREFIX", "(qaohv)~&@%+");
+    IRCBench::applyFeatures(irc);
+    IRCBench::channel(irc, "#big").joined = true;
+    const char *prefixes[] = {"", "", "", "+", "@+", "~@"};
+    std::vector<std::string> lines;
+    std::string line;
+    for (unsigned i = 0; i < state.range(0); i++) {
+        if (line.length() > 400) {
+            lines.push_back(line);
+            line.clear();
+        }
+        if (line.empty())
+            line = ":irc.example.net 353 Bot = #big :";
+        else
+            line += ' ';
+        line += prefixes[i % 6] + ("user" + std::to_string(i)) + "!ident" + std::to_string(i) + "@host" +
+                std::to_string(i % 5000) + ".example";
+    }
+    lines.push_back(line);
+
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        for (auto &names : lines)
+            IRCBench::feed(irc, names);
+        IRCBench::commitNames(irc, "#big");
+        counter.operation();
+    }
+}
+
+static void BM_ApplyModes(benchmark::State &state) {
+    // A mass op and its reversal, 24 changes each, on a channel of 1000
+    IRC irc;
+    IRCBench::setFeature(irc, "CASEMAPPING", "rfc1459");
+    IRCBench::setFeature(irc, "CHANMODES", "beI,k,l,imnpst");
+    IRCBench::setFeature(irc, "PREFIX", "(qaohv)~&@%+");
+    IRCBench::applyFeatures(irc);
+    IRCBench::channel(irc, "#modes").joined = true;
+    std::string names = ":irc.example.net 353 Bot = #modes :";
+    for (unsigned i = 0; i < 1000; i++)
+        names += "user" + std::to_string(i) + " ";
+    IRCBench::feed(irc, names);
+    IRCBench::commitNames(irc, "#modes");
+
+    std::pmr::vector<std::string> set = {"#modes", "+oooooooooovvvvvvvvvmntlk"}, unset = {"#modes", "-oooooooooovvvvvvvvvmntlk"};
+    for (unsigned i = 0; i < 19; i++) {
+        set.push_back("user" + std::to_string(i * 50));
+        unset.push_back(set.back());
+    }
+    set.push_back("50");
+    set.push_back("key");
+    unset.push_back("key");
+
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        IRCBench::applyModes(irc, "#modes", set);
+        IRCBench::applyModes(irc, "#modes", unset);
+        counter.operation();
+    }
+}
+
+static void BM_PublishSnapshot(benchmark::State &state) {
+    // One membership change per publish should only rebuild its own channel and shard
+    IRC irc;
+    IRCBench::setFeature(irc, "CASEMAPPING", "rfc1459");
+    IRCBench::setFeature(irc, "PREFIX", "(ov)@+");
+    IRCBench::applyFeatures(irc);
+    for (int64_t c = 0; c < state.range(0); c++) {
+        std::string name = "#channel" + std::to_string(c);
+        IRCBench::channel(irc, name).joined = true;
+        std::string names = ":irc.example.net 353 Bot = " + name + " :";
+        for (unsigned i = 0; i < 50; i++)
+            names += "user" + std::to_string((c * 7 + i) % 5000) + " ";
+        IRCBench::feed(irc, names);
+        IRCBench::commitNames(irc, name);
+    }
+    IRCBench::publish(irc);
+
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        IRCBench::feed(irc, ":visitor!v@example.net JOIN #channel0");
+        IRCBench::publish(irc);
+        IRCBench::feed(irc, ":visitor!v@example.net PART #channel0");
+        IRCBench::publish(irc);
+        counter.operation();
+    }
+}
+
+static void BM_MaskSetMatch(benchmark::State &state) {
+    // A lookup should cost about the same for any number of masks
+    CaseMapping caseMapping;
+    MaskSet masks(caseMapping);
+    for (int64_t i = 0; masks.size() < (size_t)state.range(0); i++) {
+        std::string n = std::to_string(i);
+        switch (i % 4) {
+        case 0:
+            masks.add("Bad" + n + "*!*@*");
+            break;
+        case 1:
+            masks.add("*!*@*.spam" + n + ".example");
+            break;
+        case 2:
+            masks.add("*!~troll" + n + "@*");
+            break;
+        case 3:
+            masks.add("Nick" + n + "!user@host" + n + ".example");
+            break;
+        }
+    }
+    std::vector<std::string> nicks, users, hosts;
+    for (unsigned i = 0; i < 1000; i++) {
+        nicks.push_back("User[" + std::to_string(i) + "]");
+        users.push_back("~ident" + std::to_string(i));
+        hosts.push_back("dsl-" + std::to_string(i) + ".isp" + std::to_string(i % 50) + ".example.net");
+    }
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        size_t index = i++ % nicks.size();
+        benchmark::DoNotOptimize(masks.matches({nicks[index], users[index], hosts[index], {}}));
+        counter.operation();
+    }
+}
+
+static void BM_TriggerScan(benchmark::State &state) {
+    // A scan should cost about the same for any number of keywords
+    TriggerSet triggers;
+    for (int64_t i = 0; i < state.range(0); i++)
+        triggers.addKeyword("keyword" + std::to_string(i), i % 2);
+    triggers.addRegex("https?://\\S+");
+    triggers.addRegex("(?i)\\bbug\\s*#?\\d+");
+    auto lines = texts("ircv3-tags.txt");
+    std::vector<std::pair<TriggerSet::Id, std::string_view>> matches;
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        matches.clear();
+        triggers.scan(lines[i++ % lines.size()], matches);
+        benchmark::DoNotOptimize(matches.data());
+        counter.operation();
+    }
+}
+
+static void BM_NearDuplicates(benchmark::State &state, const char *name) {
+    // Fingerprints and records every line, as the flood module does
+    auto lines = texts(name);
+    NearDuplicates duplicates(8192, 60000);
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        auto &line = lines[i % lines.size()];
+        benchmark::DoNotOptimize(duplicates.add(NearDuplicates::signature(line), i % 64, i));
+        i++;
+        counter.operation();
+    }
+}
+
+static void BM_StripFormatting(benchmark::State &state, const char *name) {
+    auto lines = texts(name);
+    IRC irc;
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(IRCBench::stripFormatting(irc, lines[i++ % lines.size()]));
+        counter.operation();
+    }
+}
+
+static void BM_StripFormattingView(benchmark::State &state, const char *name) {
+    // Without the copy into a std::string, reusing the storage
+    auto lines = texts(name);
+    std::string storage;
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(geblaat::IRCFormatting::strip(lines[i++ % lines.size()], storage));
+        counter.operation();
+    }
+}
+
+static void BM_SplitString(benchmark::State &state, const char *name) {
+    auto lines = texts(name);
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(splitString(lines[i++ % lines.size()]));
+        counter.operation();
+    }
+}
+
+static void BM_StringTokenizer(benchmark::State &state, const char *name) {
+    auto lines = texts(name);
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        for (auto token : StringTokenizer(lines[i++ % lines.size()]))
+            benchmark::DoNotOptimize(token);
+        counter.operation();
+    }
+}
+
+static void BM_MessageToClient(benchmark::State &state, const char *name) {
+    IRC irc;
+    std::vector<IRC::IRCMessage> messages;
+    for (auto &line : corpus(name)) {
+        IRCBench::View view;
+        if (IRCBench::parse(line, view) && view.parameterCount)
+            messages.push_back(IRCBench::toMessage(irc, view));
+    }
+    AllocationCounter counter(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(IRCBench::messageToClient(irc, messages[i++ % messages.size()]));
+        counter.operation();
+    }
+}
+
+BENCHMARK_CAPTURE(BM_ParseMessageView, ircv3_tags, "ircv3-tags.txt");
+BENCHMARK_CAPTURE(BM_ParseMessageView, names, "names.txt");
+BENCHMARK_CAPTURE(BM_ParseMessageView, colours, "colours.txt");
+BENCHMARK_CAPTURE(BM_ParseMessageView, utf8_nicks, "utf8-nicks.txt");
+BENCHMARK_CAPTURE(BM_ParseMessage, ircv3_tags, "ircv3-tags.txt");
+BENCHMARK_CAPTURE(BM_ParseMessage, names, "names.txt");
+BENCHMARK_CAPTURE(BM_ParseMessage, colours, "colours.txt");
+BENCHMARK_CAPTURE(BM_ParseMessage, utf8_nicks, "utf8-nicks.txt");
+BENCHMARK(BM_ParseTags);
+BENCHMARK(BM_FormatTags);
+BENCHMARK(BM_SplitUserNickHost);
+BENCHMARK_CAPTURE(BM_ToLower, ascii, "ascii");
+BENCHMARK_CAPTURE(BM_ToLower, rfc1459, "rfc1459");
+BENCHMARK_CAPTURE(BM_ToLower, rfc1459_strict, "rfc1459-strict");
+BENCHMARK_CAPTURE(BM_ToLower, rfc8265, "rfc8265");
+BENCHMARK(BM_ToLowerUtf8);
+BENCHMARK_CAPTURE(BM_IsEqual, ascii, "ascii");
+BENCHMARK_CAPTURE(BM_IsEqual, rfc1459, "rfc1459");
+BENCHMARK_CAPTURE(BM_IsEqual, rfc8265, "rfc8265");
+BENCHMARK(BM_ChannelLookup);
+BENCHMARK(BM_UserChurn)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_NamesIngest)->Arg(100)->Arg(10000);
+BENCHMARK(BM_ApplyModes);
+BENCHMARK(BM_PublishSnapshot)->Arg(100)->Arg(10000);
+BENCHMARK(BM_MaskSetMatch)->Arg(100)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_TriggerScan)->Arg(10)->Arg(1000)->Arg(100000);
+BENCHMARK_CAPTURE(BM_NearDuplicates, colours, "colours.txt");
+BENCHMARK_CAPTURE(BM_NearDuplicates, plain, "ircv3-tags.txt");
+BENCHMARK_CAPTURE(BM_StripFormatting, colours, "colours.txt");
+BENCHMARK_CAPTURE(BM_StripFormatting, plain, "ircv3-tags.txt");
+BENCHMARK_CAPTURE(BM_StripFormattingView, colours, "colours.txt");
+BENCHMARK_CAPTURE(BM_StripFormattingView, plain, "ircv3-tags.txt");
+BENCHMARK_CAPTURE(BM_FormattedText, colours_none, "colours.txt", "none");
+BENCHMARK_CAPTURE(BM_FormattedText, colours_plain, "colours.txt", "plain");
+BENCHMARK_CAPTURE(BM_FormattedText, colours_ansi, "colours.txt", "ansi");
+BENCHMARK_CAPTURE(BM_FormattedText, colours_html, "colours.txt", "html");
+BENCHMARK_CAPTURE(BM_SplitText, colours, "colours.txt");
+BENCHMARK_CAPTURE(BM_SplitText, utf8_nicks, "utf8-nicks.txt");
+BENCHMARK_CAPTURE(BM_SplitString, names, "names.txt");
+BENCHMARK_CAPTURE(BM_SplitString, plain, "ircv3-tags.txt");
+BENCHMARK_CAPTURE(BM_StringTokenizer, names, "names.txt");
+BENCHMARK_CAPTURE(BM_StringTokenizer, plain, "ircv3-tags.txt");
+BENCHMARK_CAPTURE(BM_MessageToClient, ircv3_tags, "ircv3-tags.txt");
+BENCHMARK_CAPTURE(BM_MessageToClient, utf8_nicks, "utf8-nicks.txt");
+
+int main(int argc, char **argv) {
+    const std::string corpusOption = "--corpus=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.starts_with(corpusOption))
+            corpusDirectory = arg.substr(corpusOption.length());
+    }
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
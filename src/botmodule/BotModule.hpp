@@ -34,6 +34,11 @@ namespace geblaat {
 class BotClient;
 class BotModule : public PluginLoadable {
   public:
+    virtual ~BotModule() {
+        // The handlers it registered must not outlive it
+        if (mBotClient)
+            mBotClient->unregisterBotModule(this);
+    }
     void setBotClient(BotClient *botclient) { mBotClient = botclient; }
 
   protected:
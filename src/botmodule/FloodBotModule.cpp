@@ -0,0 +1,232 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "FloodBotModule.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include "logger.hpp"
+namespace geblaat {
+
+FloodBotModule::~FloodBotModule() {
+    if (mBotClient) {
+        for (auto &ignored : mIgnored)
+            mBotClient->unignore(ignored.first);
+    }
+}
+
+static int64_t now(void) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t hash(std::string_view str) { return std::hash<std::string_view>()(str); }
+
+int FloodBotModule::setConfig(const nlohmann::json &cfg) {
+    config = cfg;
+    if (!mBotClient)
+        return -1;
+
+    auto number = [](const nlohmann::json &object, const char *key, double fallback) {
+        return object.is_object() && object.contains(key) && object[key].is_number() ? object[key].get<double>() : fallback;
+    };
+    try {
+        // "sender": {"messages": 5, "seconds": 5}, also "channel" and
+        // "duplicates", which take "hosts", "similarity" and "minLength"
+        auto sender = config.contains("sender") ? config["sender"] : nlohmann::json();
+        auto channel = config.contains("channel") ? config["channel"] : nlohmann::json();
+        auto duplicates = config.contains("duplicates") ? config["duplicates"] : nlohmann::json();
+        size_t slots = number(config, "slots", 4096);
+
+        mSenders = std::make_unique<RateLimiter>(slots, number(sender, "messages", 5), number(sender, "seconds", 5) * 1000);
+        mChannels = std::make_unique<RateLimiter>(slots, number(channel, "messages", 20), number(channel, "seconds", 5) * 1000);
+        mActions = std::make_unique<RateLimiter>(slots, 1, number(config, "cooldown", 60) * 1000);
+        mDuplicates = std::make_unique<NearDuplicates>(number(duplicates, "capacity", 8192), number(duplicates, "seconds", 60) * 1000,
+                                                       number(duplicates, "similarity", 0.5));
+        mDuplicateHosts = number(duplicates, "hosts", 3);
+        mMinimumLength = number(duplicates, "minLength", 20);
+
+        // "ignore": {"seconds": 600, "masks": 256}, how long and how many
+        // hosts are ignored at most
+        auto ignore = config.contains("ignore") ? config["ignore"] : nlohmann::json();
+        mIgnoreTime = number(ignore, "seconds", 600) * 1000;
+        mIgnoreLimit = std::max(1.0, number(ignore, "masks", 256));
+
+        // "actions": ["kick", "ban", "ignore"]
+        if (config.contains("actions") && config["actions"].is_array()) {
+            mKick = mBan = mIgnore = false;
+            for (auto &action : config["actions"]) {
+                if (action == "kick")
+                    mKick = true;
+                else if (action == "ban")
+                    mBan = true;
+                else if (action == "ignore")
+                    mIgnore = true;
+                else
+                    LOG_WARNING("Unknown action %s", action.dump().c_str());
+            }
+        }
+        if (config.contains("reason") && config["reason"].is_string())
+            mReason = config["reason"];
+        // Set on a channel that floods as a whole, such as "+m"
+        if (config.contains("channelModes") && config["channelModes"].is_string())
+            mChannelModes = config["channelModes"];
+
+        mExempt.clear();
+        if (config.contains("exempt") && config["exempt"].is_array()) {
+            for (auto &mask : config["exempt"])
+                if (mask.is_string() && mExempt.add(mask.get<std::string>()) == MaskSet::none)
+                    LOG_WARNING("Unsupported exempt mask %s", mask.dump().c_str());
+        }
+    } catch (std::exception &ex) {
+        LOG_ERROR("Configuration error: %s", ex.what());
+        return -1;
+    }
+
+    mBotClient->registerMessageHandler(this, [this](const std::map<std::string, std::string> &message) { onMessage(message); });
+    // Hosts and exempt masks compare as the network does
+    mBotClient->registerEventHandler(this, "casemapping", [this](const std::map<std::string, std::string> &message) {
+        auto caseMapping = message.find("casemapping");
+        mCaseMapping.configure(caseMapping != message.end() ? caseMapping->second : "rfc1459", message.contains("casemapping/utf8"));
+        mExempt.rebuild();
+    });
+    return 0;
+}
+
+void FloodBotModule::onMessage(const std::map<std::string, std::string> &message) {
+    auto value = [&message](const char *key) -> std::string_view {
+        auto it = message.find(key);
+        return it != message.end() ? std::string_view(it->second) : std::string_view();
+    };
+    if (message.contains("echo"))
+        // What we said ourselves
+        return;
+    auto host = value("sender/irc/host");
+    if (host.empty())
+        // From a server
+        return;
+    if (mExempt.size() && mExempt.matches({value("sender/irc/nick"), value("sender/irc/user"), host, value("sender/irc/account")}))
+        return;
+
+    int64_t time = now();
+    expireIgnores(time);
+    std::string foldedHost(host);
+    mCaseMapping.fold(foldedHost);
+    uint64_t hostKey = hash(foldedHost);
+
+    if (value("target/type") == "channel") {
+        // The channel name is folded already
+        uint64_t channelKey = hash(value("target"));
+        if (mChannels->hit(channelKey, time) >= mChannels->limit() && mChannelModes.length() &&
+            mActions->count(~channelKey, time) == 0) {
+            mActions->hit(~channelKey, time);
+            LOG_WARNING("Channel %s is flooded", std::string(value("target")).c_str());
+            std::map<std::string, std::string> mode;
+            mode["type"] = "mode";
+            mode["target"] = value("target");
+            mode["mode"] = mChannelModes;
+            mBotClient->sendMessage(mode);
+        }
+    }
+
+    if (mSenders->hit(hostKey, time) >= mSenders->limit()) {
+        punish(message, hostKey, "Flood");
+        return;
+    }
+
+    auto text = mBotClient->text(message);
+    if (text.length() >= mMinimumLength &&
+        mDuplicates->add(NearDuplicates::signature(text), hostKey, time) >= mDuplicateHosts)
+        punish(message, hostKey, "Spam");
+}
+
+void FloodBotModule::punish(const std::map<std::string, std::string> &message, uint64_t host, const char *why) {
+    int64_t time = now();
+    if (mActions->count(host, time))
+        // Acted upon already
+        return;
+    mActions->hit(host, time);
+
+    auto raw = message.find("sender/irc/raw");
+    LOG_WARNING("%s from %s", why, raw != message.end() ? raw->second.c_str() : "");
+
+    std::string mask = "*!*@" + message.at("sender/irc/host");
+    auto type = message.find("target/type");
+    if (type != message.end() && type->second == "channel") {
+        if (mBan) {
+            std::map<std::string, std::string> ban;
+            ban["type"] = "mode";
+            ban["target"] = message.at("target");
+            ban["mode"] = "+b " + mask;
+            mBotClient->sendMessage(ban);
+        }
+        if (mKick && message.contains("sender/irc/nick")) {
+            std::map<std::string, std::string> kick;
+            kick["type"] = "kick";
+            kick["target"] = message.at("target");
+            kick["nick"] = message.at("sender/irc/nick");
+            kick["text/plain"] = mReason;
+            mBotClient->sendMessage(kick);
+        }
+    }
+    if (mIgnore && mBotClient->ignore(mask)) {
+        if (mIgnored.size() >= mIgnoreLimit) {
+            mBotClient->unignore(mIgnored.front().first);
+            mIgnored.pop_front();
+        }
+        mIgnored.emplace_back(mask, time + mIgnoreTime);
+    }
+}
+
+void FloodBotModule::expireIgnores(int64_t now) {
+    while (mIgnored.size() && mIgnored.front().second <= now) {
+        mBotClient->unignore(mIgnored.front().first);
+        mIgnored.pop_front();
+    }
+}
+
+} // namespace geblaat
+
+#if defined DYNAMIC_LIBRARY
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wattributes"
+
+extern "C" {
+[[gnu::cdecl]] geblaat::FloodBotModule *newInstance(void) { return new geblaat::FloodBotModule(); }
+[[gnu::cdecl]] void delInstance(geblaat::FloodBotModule *inst) { delete inst; }
+
+pluginloadable_t plugin_info = {
+    .name = "Flood protection",
+    .description = "Kicks, bans or ignores flooders and spammers",
+    .abi = {.abi = pluginloadable_abi_cpp, .version = 0},
+};
+}
+
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,87 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "BotModule.hpp"
+#include "caseMapping.hpp"
+#include "maskSet.hpp"
+#include "nearDuplicates.hpp"
+#include "rateLimiter.hpp"
+
+namespace geblaat {
+
+// Detects flooding and botnet spam. Every message is counted against its
+// host and its channel in sliding windows, and the texts are compared with
+// what other hosts recently sent on any channel. Offenders are kicked,
+// banned and/or ignored, as configured. All state has a fixed size, under
+// attack the oldest state is forgotten first.
+class FloodBotModule : public BotModule {
+  public:
+    virtual ~FloodBotModule();
+    int setConfig(const nlohmann::json &) override;
+    nlohmann::json getConfig(void) override { return config; }
+
+  private:
+    void onMessage(const std::map<std::string, std::string> &message);
+    void punish(const std::map<std::string, std::string> &message, uint64_t host, const char *why);
+    void expireIgnores(int64_t now);
+
+    nlohmann::json config;
+
+    std::unique_ptr<RateLimiter> mSenders;
+    std::unique_ptr<RateLimiter> mChannels;
+    // Hosts and channels acted upon, so we act only once per cooldown
+    std::unique_ptr<RateLimiter> mActions;
+    std::unique_ptr<NearDuplicates> mDuplicates;
+    unsigned mDuplicateHosts = 3;
+    size_t mMinimumLength = 20;
+
+    bool mKick = true;
+    bool mBan = false;
+    bool mIgnore = false;
+    std::string mReason = "Flooding";
+    std::string mChannelModes;
+
+    // The masks we ignored and when to unignore them, oldest first. When
+    // full the oldest is unignored early.
+    std::deque<std::pair<std::string, int64_t>> mIgnored;
+    size_t mIgnoreLimit = 256;
+    int64_t mIgnoreTime = 600 * 1000;
+
+    CaseMapping mCaseMapping;
+    MaskSet mExempt{mCaseMapping};
+};
+
+} // namespace geblaat
@@ -82,6 +82,12 @@ int TestBotModule::setConfig(const nlohmann::json &cfg) {
                 onLoadQuotes(command, parameters, message);
             });
 
+        auto onNetsplit = [this](const std::map<std::string, std::string> &event) { this->onNetsplit(event); };
+        mBotClient->registerEventHandler(this, "netsplit", onNetsplit);
+        mBotClient->registerEventHandler(this, "netjoin", onNetsplit);
+        if (config.contains("announce") && config["announce"].is_string())
+            announceChannel = config["announce"];
+
         if (config.contains("quotefile")) {
             if (config["quotefile"].is_string()) {
                 quoteFileName = config["quotefile"];
@@ -123,6 +129,25 @@ void TestBotModule::onRandomQuote(std::string command, std::string parameters, s
     mBotClient->sendMessage(sendMessage);
 }
 
+void TestBotModule::onNetsplit(const std::map<std::string, std::string> &event) {
+    auto value = [&event](const char *key) -> std::string {
+        auto it = event.find(key);
+        return it != event.end() ? it->second : "";
+    };
+    std::string text = value("type") == "netsplit" ? "Netsplit" : "Netjoin";
+    text += " between " + value("irc/batch/server1") + " and " + value("irc/batch/server2") + ", " + value("irc/batch/count") +
+            " users";
+    LOG_INFO("%s", text.c_str());
+
+    if (announceChannel.length()) {
+        std::map<std::string, std::string> sendMessage;
+        sendMessage["type"] = "message";
+        sendMessage["target"] = announceChannel;
+        sendMessage["text/plain"] = text;
+        mBotClient->sendMessage(sendMessage);
+    }
+}
+
 void TestBotModule::onTest(std::string command, std::string parameters, std::map<std::string, std::string> recvMessage) {
     std::map<std::string, std::string> sendMessage;
 
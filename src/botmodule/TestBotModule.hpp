@@ -46,6 +46,7 @@ class TestBotModule : public BotModule {
     void onTest(std::string command, std::string parameters, std::map<std::string, std::string> message);
     void onRandomQuote(std::string command, std::string parameters, std::map<std::string, std::string> message);
     void onLoadQuotes(std::string command, std::string parameters, std::map<std::string, std::string> me);
+    void onNetsplit(const std::map<std::string, std::string> &event);
 
     std::string getRandomQuote(void);
     void loadQuotes(void);
@@ -53,6 +54,8 @@ class TestBotModule : public BotModule {
     nlohmann::json config;
 
     std::string quoteFileName;
+    // Netsplits and netjoins are announced here, when set
+    std::string announceChannel;
     std::vector<std::string> mQuotes;
 };
 
@@ -98,7 +98,95 @@ void BotClient::registerBotCommand(BotModule *mod, std::string command, OnComman
     if (mBotModules.contains(mod)) {
         auto prefix = mBotModules[mod];
         LOG_INFO("Registering Bot Command, Prefix %s, Command %s", prefix.c_str(), command.c_str());
-        mCommands[prefix][command] = cmd;
+        mCommands[prefix][command] = {mod, cmd};
+    } else {
+        LOG_ERROR("Bot Module Not Registered");
+    }
+}
+
+void BotClient::registerMessageHandler(BotModule *mod, OnMessage handler) {
+    if (mBotModules.contains(mod)) {
+        LOG_INFO("Registering message handler");
+        mMessageHandlers[mod] = handler;
+    } else {
+        LOG_ERROR("Bot Module Not Registered");
+    }
+}
+
+void BotClient::registerEventHandler(BotModule *mod, std::string type, OnMessage handler) {
+    if (mBotModules.contains(mod)) {
+        LOG_INFO("Registering event handler for %s", type.c_str());
+        mEventHandlers[type][mod] = handler;
+        // The network's case mapping may have been announced already
+        if (type == "casemapping" && mCaseMappingMessage.size())
+            handler(mCaseMappingMessage);
+    } else {
+        LOG_ERROR("Bot Module Not Registered");
+    }
+}
+
+void BotClient::unregisterBotModule(BotModule *mod) {
+    mBotModules.erase(mod);
+    mMessageHandlers.erase(mod);
+    for (auto &handlers : mEventHandlers)
+        handlers.second.erase(mod);
+    for (auto &subscribers : mSubscriptions)
+        subscribers.second.erase(mod);
+    for (auto prefixed = mCommands.begin(); prefixed != mCommands.end();) {
+        std::erase_if(prefixed->second, [mod](auto &command) { return command.second.first == mod; });
+        if (prefixed->second.empty())
+            prefixed = mCommands.erase(prefixed);
+        else
+            ++prefixed;
+    }
+    for (TriggerSet::Id id = 0; id < mTriggers.size(); id++) {
+        if (mTriggers[id].first == mod) {
+            mTriggerSet.remove(id);
+            mTriggers[id] = {};
+        }
+    }
+}
+
+bool BotClient::registerKeywordTrigger(BotModule *mod, std::string keyword, OnTrigger trigger, bool wholeWord) {
+    if (!mBotModules.contains(mod)) {
+        LOG_ERROR("Bot Module Not Registered");
+        return false;
+    }
+    auto id = mTriggerSet.addKeyword(keyword, wholeWord);
+    if (id == TriggerSet::none) {
+        LOG_ERROR("Cannot register an empty keyword");
+        return false;
+    }
+    LOG_INFO("Registering keyword trigger %s", keyword.c_str());
+    mTriggers.resize(id + 1);
+    mTriggers[id] = {mod, trigger};
+    return true;
+}
+
+bool BotClient::registerRegexTrigger(BotModule *mod, std::string regex, OnTrigger trigger) {
+    if (!mBotModules.contains(mod)) {
+        LOG_ERROR("Bot Module Not Registered");
+        return false;
+    }
+    std::string error;
+    auto id = mTriggerSet.addRegex(regex, &error);
+    if (id == TriggerSet::none) {
+        LOG_ERROR("Cannot register regex trigger %s: %s", regex.c_str(), error.c_str());
+        return false;
+    }
+    LOG_INFO("Registering regex trigger %s", regex.c_str());
+    mTriggers.resize(id + 1);
+    mTriggers[id] = {mod, trigger};
+    return true;
+}
+
+void BotClient::subscribe(BotModule *mod, std::string event, OnMessage handler) {
+    if (mBotModules.contains(mod) && mProtocol) {
+        for (auto &c : event)
+            c = toupper((unsigned char)c);
+        LOG_INFO("Subscribing to %s", event.c_str());
+        mSubscriptions[event][mod] = handler;
+        mProtocol->subscribe(event);
     } else {
         LOG_ERROR("Bot Module Not Registered");
     }
@@ -115,6 +203,14 @@ int BotClient::setConfig(const nlohmann::json &cfg) {
 
         pluginLoader->registerPluginLoader([this](PluginLoader::Plugin &plugin) { CapiBotModuleLoader(plugin); });
 
+        mIgnore.clear();
+        auto ignoreList = config["ignore"];
+        if (ignoreList.is_array()) {
+            for (auto &mask : ignoreList)
+                if (mask.is_string())
+                    ignore(mask);
+        }
+
         auto networks = config["networks"];
         if (networks.is_array()) {
             for (auto &network : networks) {
@@ -158,7 +254,7 @@ int BotClient::setConfig(const nlohmann::json &cfg) {
     }
 
     // Testing the command structure
-    mCommands["!"]["blaat"] = [this](std::string command, std::string parameter, std::map<std::string, std::string> recvMessage) {
+    mCommands["!"]["blaat"].second = [this](std::string command, std::string parameter, std::map<std::string, std::string> recvMessage) {
         LOG_INFO("command is %s", command.c_str());
         LOG_INFO("parameter is %s", parameter.c_str());
 
@@ -181,6 +277,39 @@ int BotClient::setConfig(const nlohmann::json &cfg) {
 
 void BotClient::sendMessage(std::map<std::string, std::string> message) { mProtocol->sendMessage(message); }
 
+std::string_view BotClient::text(const std::map<std::string, std::string> &message, std::string_view format) {
+    auto it = message.find("text/" + std::string(format));
+    if (it != message.end())
+        return it->second;
+    return mProtocol ? mProtocol->text(format) : std::string_view();
+}
+
+std::shared_ptr<const ChannelSnapshots> BotClient::channels(void) { return mProtocol ? mProtocol->channels() : nullptr; }
+
+bool BotClient::ignore(const std::string &mask) {
+    if (mIgnore.add(mask) == MaskSet::none) {
+        LOG_WARNING("Cannot ignore %s, unsupported mask", mask.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool BotClient::unignore(const std::string &mask) { return mIgnore.remove(mask); }
+
+bool BotClient::isIgnored(const std::map<std::string, std::string> &message) const {
+    if (!mIgnore.size())
+        return false;
+    auto nick = message.find("sender/irc/nick");
+    if (nick == message.end())
+        return false;
+
+    auto value = [&message](const char *key) -> std::string_view {
+        auto it = message.find(key);
+        return it != message.end() ? std::string_view(it->second) : std::string_view();
+    };
+    return mIgnore.matches({nick->second, value("sender/irc/user"), value("sender/irc/host"), value("sender/irc/account")});
+}
+
 BotClient::~BotClient() {
     // TODO Auto-generated destructor stub
     if (mProtocol)
@@ -188,33 +317,97 @@ BotClient::~BotClient() {
 }
 
 void BotClient::onMessage(std::map<std::string, std::string> message) {
-    if (message.contains("type")) {
-        if (message["type"] == "message") {
-            if (message.contains("text/plain")) {
-                if (message["text/plain"].length()) {
-                    for (auto &prefixedCommand : mCommands) {
-                        auto prefix = prefixedCommand.first;
-
-                        auto isbotcommand = message["text/plain"].find(prefix);
-                        if (isbotcommand == 0) {
-                            auto endbotcommand = message["text/plain"].find(" ");
-                            std::string botcommand, params;
-                            if (endbotcommand == std::string::npos) {
-                                botcommand = message["text/plain"].substr(1);
-                                params = "";
-                            } else {
-                                botcommand = message["text/plain"].substr(1, endbotcommand - 1);
-                                params = message["text/plain"].substr(endbotcommand + 1);
-                            }
-                            if (prefixedCommand.second.contains(botcommand)) {
-                                prefixedCommand.second[botcommand](botcommand, params, message);
-                            }
-                        }
-                    }
+    auto type = message.find("type");
+    if (type != message.end() && type->second == "casemapping") {
+        mCaseMapping.configure(message["casemapping"], message.contains("casemapping/utf8"));
+        mIgnore.rebuild();
+        // Modules comparing names follow it too
+        mCaseMappingMessage = message;
+        auto handlers = mEventHandlers.find("casemapping");
+        if (handlers != mEventHandlers.end()) {
+            for (auto &handler : handlers->second)
+                handler.second(message);
+        }
+        return;
+    }
+    if (isIgnored(message)) {
+        LOG_DEBUG("Ignoring message from %s", message["sender/irc/raw"].c_str());
+        return;
+    }
+
+    if (type == message.end())
+        return;
+    if (type->second == "irc") {
+        std::string command = message["irc/command"];
+        for (auto &c : command)
+            c = toupper((unsigned char)c);
+        auto subscribers = mSubscriptions.find(command);
+        if (subscribers != mSubscriptions.end()) {
+            for (auto &subscriber : subscribers->second)
+                subscriber.second(message);
+        }
+        return;
+    }
+    if (type->second != "message" && type->second != "action" && type->second != "notice") {
+        auto handlers = mEventHandlers.find(type->second);
+        if (handlers != mEventHandlers.end()) {
+            for (auto &handler : handlers->second)
+                handler.second(message);
+        }
+        return;
+    }
+    if (mMessageHandlers.size()) {
+        for (auto &handler : mMessageHandlers)
+            handler.second(message);
+        // A handler may have ignored the sender
+        if (isIgnored(message))
+            return;
+    }
+    if (type->second == "notice")
+        return;
+
+    auto text = this->text(message);
+    if (text.empty())
+        return;
+    // Commands and triggers get the plain text with the message, they may
+    // keep it beyond this call
+    auto withText = [&message, text]() -> std::map<std::string, std::string> & {
+        if (!message.contains("text/plain"))
+            message["text/plain"] = text;
+        return message;
+    };
+
+    if (type->second == "message") {
+        for (auto &prefixedCommand : mCommands) {
+            auto &prefix = prefixedCommand.first;
+            if (text.starts_with(prefix)) {
+                auto endbotcommand = text.find(" ");
+                std::string botcommand, params;
+                if (endbotcommand == std::string_view::npos) {
+                    botcommand = text.substr(prefix.length());
+                    params = "";
+                } else {
+                    botcommand = text.substr(prefix.length(), endbotcommand - prefix.length());
+                    params = text.substr(endbotcommand + 1);
+                }
+                auto command = prefixedCommand.second.find(botcommand);
+                if (command != prefixedCommand.second.end()) {
+                    command->second.second(botcommand, params, withText());
                 }
             }
         }
     }
+
+    if (mTriggerSet.size()) {
+        mTriggerMatches.clear();
+        mTriggerSet.scan(text, mTriggerMatches);
+        for (auto &match : mTriggerMatches) {
+            // A copy, the trigger may register another one
+            auto trigger = mTriggers[match.first].second;
+            if (trigger)
+                trigger(std::string(match.second), withText());
+        }
+    }
 }
 
 } /* namespace geblaat */
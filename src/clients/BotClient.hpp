@@ -33,13 +33,18 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <string_view>
 
 // Third Party libraries
 #include <nlohmann/json.hpp>
 
 // Project includes
 
+#include "../protocol/ChannelSnapshot.hpp"
 #include "Client.hpp"
+#include "caseMapping.hpp"
+#include "maskSet.hpp"
+#include "triggerSet.hpp"
 
 // So this is my issue... once I include the PluginLoader here I get errors
 // regarding BotClient not found in PluginLoader. A circular reference problem.
@@ -61,8 +66,55 @@ class BotClient : public Client {
     using OnCommand = std::function<void(std::string command, std::string parameters, std::map<std::string, std::string> message)>;
 
     void registerBotCommand(BotModule *mod, std::string command, OnCommand cmd);
+
+    // Called for every message, notice and action not from an ignored user,
+    // before the commands and triggers. One handler per module.
+    using OnMessage = std::function<void(const std::map<std::string, std::string> &message)>;
+    void registerMessageHandler(BotModule *mod, OnMessage handler);
+
+    // Called for the other events of the protocol by type, such as the
+    // "netsplit", "netjoin" and "history" events aggregated from IRCv3
+    // batches. One handler per module and type. A "casemapping" handler is
+    // called right away when the network's case mapping is already known.
+    void registerEventHandler(BotModule *mod, std::string type, OnMessage handler);
+
+    // Called with the text a trigger matched in a message or action
+    using OnTrigger = std::function<void(std::string match, std::map<std::string, std::string> message)>;
+
+    // Keywords match case insensitive anywhere in the text, or only as a
+    // whole word. Regular expressions use the RE2 syntax, in a build with
+    // ENABLE_RE2. All triggers are matched in a single scan of the text.
+    // Return false when the trigger could not be registered.
+    bool registerKeywordTrigger(BotModule *mod, std::string keyword, OnTrigger trigger, bool wholeWord = false);
+    bool registerRegexTrigger(BotModule *mod, std::string regex, OnTrigger trigger);
+
+    // Passes the protocol's "irc" events for a command, such as "INVITE",
+    // "JOIN" or a numeric, to the handler. A command the protocol handles
+    // itself is passed on after that, lines in a batch come with the
+    // batch's event instead. One handler per module and command.
+    void subscribe(BotModule *mod, std::string event, OnMessage handler);
     void sendMessage(std::map<std::string, std::string> message);
 
+    // Forgets a module that is going away, with its handlers, commands and
+    // triggers
+    void unregisterBotModule(BotModule *mod);
+
+    // The text of a message in a format such as "plain" or "html". Taken
+    // from the message when the protocol added it, otherwise rendered on
+    // demand, which only works while the message is being handled.
+    std::string_view text(const std::map<std::string, std::string> &message, std::string_view format = "plain");
+
+    // The channels of the network, safe to use from any thread. See
+    // ChannelSnapshot.hpp, nullptr when not available.
+    std::shared_ptr<const ChannelSnapshots> channels(void);
+
+    // Messages from users matching a mask on the ignore list are dropped
+    // before they reach any command. Masks are nick!user@host globs or
+    // account extbans, see MaskSet.
+    bool ignore(const std::string &mask);
+    bool unignore(const std::string &mask);
+    bool isIgnored(const std::map<std::string, std::string> &message) const;
+
     // PluginLoader::plugin getCapiBotModule(void *handle);
     void CapiBotModuleLoader(PluginLoader::Plugin &);
 
@@ -72,8 +124,25 @@ class BotClient : public Client {
   private:
     nlohmann::json config;
 
-    std::map<std::string, std::map<std::string, OnCommand>> mCommands;
+    // By prefix and command, with the module that registered it
+    std::map<std::string, std::map<std::string, std::pair<BotModule *, OnCommand>>> mCommands;
     std::map<BotModule *, std::string> mBotModules;
+
+    // Follows the network, as announced by "casemapping" messages
+    CaseMapping mCaseMapping;
+    std::map<std::string, std::string> mCaseMappingMessage;
+    MaskSet mIgnore{mCaseMapping};
+
+    std::map<BotModule *, OnMessage> mMessageHandlers;
+    // By command
+    std::map<std::string, std::map<BotModule *, OnMessage>> mSubscriptions;
+    // By type
+    std::map<std::string, std::map<BotModule *, OnMessage>> mEventHandlers;
+
+    TriggerSet mTriggerSet;
+    // By trigger id, with the module that registered it
+    std::vector<std::pair<BotModule *, OnTrigger>> mTriggers;
+    std::vector<std::pair<TriggerSet::Id, std::string_view>> mTriggerMatches;
 };
 
 } // namespace geblaat
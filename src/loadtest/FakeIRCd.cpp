@@ -0,0 +1,703 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "FakeIRCd.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "logger.hpp"
+#include "splitString.hpp"
+#include "threadName.hpp"
+
+namespace geblaat {
+
+FakeIRCd::FakeIRCd(Config config) : mConfig(std::move(config)) {}
+
+FakeIRCd::~FakeIRCd() { stop(); }
+
+uint16_t FakeIRCd::start(uint16_t port) {
+    mListenSocket = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (mListenSocket < 0) {
+        LOG_ERROR("Error creating socket: %s", strerror(errno));
+        return 0;
+    }
+
+    const int yes = 1;
+    setsockopt(mListenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in in = {};
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    in.sin_port = htons(port);
+    socklen_t length = sizeof(in);
+    if (::bind(mListenSocket, (const sockaddr *)&in, sizeof(in)) < 0 || ::listen(mListenSocket, SOMAXCONN) < 0 ||
+        ::getsockname(mListenSocket, (sockaddr *)&in, &length) < 0) {
+        LOG_ERROR("Error listening on port %d: %s", port, strerror(errno));
+        ::close(mListenSocket);
+        mListenSocket = -1;
+        return 0;
+    }
+    fcntl(mListenSocket, F_SETFL, O_NONBLOCK);
+
+    if (pipe(mWakeup) < 0) {
+        LOG_ERROR("Error creating pipe: %s", strerror(errno));
+        ::close(mListenSocket);
+        mListenSocket = -1;
+        return 0;
+    }
+    fcntl(mWakeup[0], F_SETFL, O_NONBLOCK);
+    fcntl(mWakeup[1], F_SETFL, O_NONBLOCK);
+
+    port = ntohs(in.sin_port);
+    LOG_INFO("Fake IRCd listening on 127.0.0.1:%d", port);
+    mRunning = true;
+    mThread = std::thread(&FakeIRCd::run, this);
+    return port;
+}
+
+void FakeIRCd::stop(void) {
+    if (!mRunning)
+        return;
+    mRunning = false;
+    wakeup();
+    mThread.join();
+
+    for (auto &session : mSessions)
+        ::close(session->socket);
+    mSessions.clear();
+    mChannels.clear();
+    ::close(mListenSocket);
+    ::close(mWakeup[0]);
+    ::close(mWakeup[1]);
+    mListenSocket = mWakeup[0] = mWakeup[1] = -1;
+}
+
+void FakeIRCd::setLineHandler(LineHandler handler) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLineHandler = handler;
+}
+
+void FakeIRCd::wakeup(void) {
+    char c = 0;
+    (void)!write(mWakeup[1], &c, 1);
+}
+
+//----------------------------------------------------------------------------
+// Server thread
+//----------------------------------------------------------------------------
+void FakeIRCd::run(void) {
+    setThreadName("FakeIRCd");
+    std::vector<pollfd> fds;
+    std::vector<std::pair<std::string, std::string>> handled;
+
+    while (mRunning) {
+        fds.clear();
+        fds.push_back({mListenSocket, POLLIN, 0});
+        fds.push_back({mWakeup[0], POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (auto &session : mSessions)
+                fds.push_back({session->socket, short(POLLIN | (session->output.empty() ? 0 : POLLOUT)), 0});
+        }
+
+        if (poll(fds.data(), fds.size(), 100) < 0) {
+            if (errno != EINTR)
+                LOG_ERROR("poll: %s", strerror(errno));
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char buffer[64];
+            while (read(mWakeup[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+        if (fds[0].revents & POLLIN)
+            accept();
+
+        LineHandler lineHandler;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            lineHandler = mLineHandler;
+            // Sessions accepted during this iteration are not in fds yet
+            for (size_t i = 2; i < fds.size(); i++) {
+                auto &session = *mSessions[i - 2];
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR) && receive(session)) {
+                    std::string_view line;
+                    while (session.socket >= 0 && session.input.nextLine(line))
+                        onLine(session, line);
+                }
+            }
+            // Any session may have received lines, by relaying or scripting
+            for (auto &session : mSessions) {
+                if (session->socket >= 0 && session->output.size())
+                    flush(*session);
+            }
+            std::erase_if(mSessions, [](auto &session) { return session->socket < 0; });
+            handled.swap(mHandled);
+        }
+
+        for (auto &line : handled)
+            lineHandler(line.first, line.second);
+        handled.clear();
+    }
+}
+
+void FakeIRCd::accept(void) {
+    while (true) {
+        int socket = ::accept(mListenSocket, nullptr, nullptr);
+        if (socket < 0)
+            return;
+        fcntl(socket, F_SETFL, O_NONBLOCK);
+        const int yes = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto session = std::make_unique<Session>();
+        session->socket = socket;
+        mSessions.push_back(std::move(session));
+    }
+}
+
+bool FakeIRCd::receive(Session &session) {
+    char buffer[8192];
+    ssize_t received = recv(session.socket, buffer, sizeof(buffer), 0);
+    if (received < 0 && (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR))
+        return true;
+    if (received <= 0) {
+        onQUIT(session, "Connection closed");
+        return false;
+    }
+    mStatistics.bytesReceived += received;
+
+    // The data is processed by the caller; a line buffer of the default
+    // capacity takes a full receive buffer whenever the previous lines
+    // have been consumed. Any remainder is processed here.
+    size_t taken = session.input.append(buffer, received);
+    while (taken < size_t(received)) {
+        std::string_view line;
+        while (session.input.nextLine(line))
+            onLine(session, line);
+        taken += session.input.append(buffer + taken, received - taken);
+    }
+    return true;
+}
+
+bool FakeIRCd::flush(Session &session) {
+    while (session.output.size()) {
+        ssize_t sent = ::send(session.socket, session.output.data(), session.output.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR)
+                return true;
+            onQUIT(session, "Write error");
+            return false;
+        }
+        mStatistics.bytesSent += sent;
+        session.output.erase(0, sent);
+    }
+    return true;
+}
+
+void FakeIRCd::close(Session &session) {
+    if (session.socket >= 0) {
+        ::close(session.socket);
+        session.socket = -1;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Protocol
+//----------------------------------------------------------------------------
+std::vector<std::string> FakeIRCd::parse(std::string_view line, std::string &command) {
+    std::vector<std::string> parameters;
+    command.clear();
+
+    // Tags sent by clients are not relayed
+    if (line.starts_with('@')) {
+        auto space = line.find(' ');
+        line.remove_prefix(space == std::string_view::npos ? line.length() : space + 1);
+    }
+    while (line.starts_with(' '))
+        line.remove_prefix(1);
+
+    while (line.length()) {
+        if (command.length() && line[0] == ':') {
+            parameters.emplace_back(line.substr(1));
+            break;
+        }
+        auto space = line.find(' ');
+        auto token = line.substr(0, space);
+        if (command.empty()) {
+            command = token;
+            std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+        } else {
+            parameters.emplace_back(token);
+        }
+        if (space == std::string_view::npos)
+            break;
+        line.remove_prefix(space + 1);
+        while (line.starts_with(' '))
+            line.remove_prefix(1);
+    }
+    return parameters;
+}
+
+std::string FakeIRCd::toLower(std::string_view str) {
+    // rfc1459, matching the advertised CASEMAPPING
+    std::string result(str);
+    for (auto &c : result) {
+        if (c >= 'A' && c <= '^')
+            c += 'a' - 'A';
+    }
+    return result;
+}
+
+void FakeIRCd::send(Session &session, const std::string &line) {
+    if (session.socket < 0)
+        return;
+    session.output += line;
+    session.output += "\r\n";
+    mStatistics.linesSent++;
+}
+
+void FakeIRCd::reply(Session &session, std::string_view numeric, const std::string &text) {
+    std::string line = ":" + mConfig.serverName + " ";
+    line += numeric;
+    line += " " + (session.nick.length() ? session.nick : "*") + " " + text;
+    send(session, line);
+}
+
+void FakeIRCd::sendToChannel(Channel &channel, const std::string &line, Session *except) {
+    for (auto member : channel.members) {
+        if (member != except)
+            send(*member, line);
+    }
+}
+
+FakeIRCd::Session *FakeIRCd::findSession(std::string_view nick) {
+    auto lowerNick = toLower(nick);
+    for (auto &session : mSessions) {
+        if (session->socket >= 0 && session->registered && toLower(session->nick) == lowerNick)
+            return session.get();
+    }
+    return nullptr;
+}
+
+FakeIRCd::Channel &FakeIRCd::channel(const std::string &name) {
+    auto key = toLower(name);
+    auto it = mChannels.find(key);
+    if (it == mChannels.end()) {
+        it = mChannels.emplace(key, Channel{}).first;
+        it->second.name = name;
+    }
+    return it->second;
+}
+
+std::string FakeIRCd::syntheticMember(const std::string &channel, unsigned index) {
+    // Unique per channel, valid as nick and user name
+    std::string nick = "m" + std::to_string(index) + "_";
+    for (auto c : channel) {
+        if (isalnum((unsigned char)c))
+            nick += c;
+    }
+    return nick.substr(0, 30);
+}
+
+void FakeIRCd::onLine(Session &session, std::string_view line) {
+    mStatistics.linesReceived++;
+    std::string command;
+    auto parameters = parse(line, command);
+    // The line handler is called once the lock is released
+    if (mLineHandler && session.registered)
+        mHandled.emplace_back(session.nick, line);
+
+    if (command == "CAP") {
+        onCAP(session, parameters);
+    } else if (command == "PASS") {
+        // Any password is accepted
+    } else if (command == "NICK") {
+        if (parameters.empty()) {
+            reply(session, "431", ":No nickname given");
+        } else if (auto other = findSession(parameters[0]); other && other != &session) {
+            reply(session, "433", parameters[0] + " :Nickname is already in use");
+        } else if (session.registered) {
+            std::string line = ":" + session.source() + " NICK :" + parameters[0];
+            send(session, line);
+            for (auto &name : session.channels)
+                sendToChannel(mChannels[name], line, &session);
+            session.nick = parameters[0];
+        } else {
+            session.nick = parameters[0];
+            onRegistered(session);
+        }
+    } else if (command == "USER") {
+        if (parameters.size() < 4) {
+            reply(session, "461", "USER :Not enough parameters");
+        } else if (!session.registered) {
+            session.user = parameters[0];
+            session.realName = parameters[3];
+            onRegistered(session);
+        }
+    } else if (command == "PING") {
+        send(session, ":" + mConfig.serverName + " PONG " + mConfig.serverName + " :" +
+                          (parameters.size() ? parameters[0] : std::string()));
+    } else if (command == "PONG") {
+    } else if (command == "QUIT") {
+        onQUIT(session, parameters.size() ? parameters[0] : "Quit");
+    } else if (!session.registered) {
+        reply(session, "451", ":You have not registered");
+    } else if (command == "JOIN" && parameters.size()) {
+        onJOIN(session, parameters[0]);
+    } else if (command == "PART" && parameters.size()) {
+        onPART(session, parameters[0]);
+    } else if (command == "NAMES" && parameters.size()) {
+        onNAMES(session, channel(parameters[0]));
+    } else if (command == "WHO" && parameters.size()) {
+        onWHO(session, parameters);
+    } else if ((command == "PRIVMSG" || command == "NOTICE") && parameters.size() > 1) {
+        onMessage(&session, session.source(), command, parameters[0], parameters[1]);
+    } else if (command == "MODE" && parameters.size()) {
+        if (toLower(parameters[0]) == toLower(session.nick))
+            send(session, ":" + session.source() + " MODE " + session.nick + " " +
+                              (parameters.size() > 1 ? parameters[1] : std::string("+")));
+        else if (mChannels.contains(toLower(parameters[0])))
+            reply(session, "324", mChannels[toLower(parameters[0])].name + " +nt");
+        else
+            reply(session, "403", parameters[0] + " :No such channel");
+    } else {
+        reply(session, "421", command + " :Unknown command");
+    }
+}
+
+void FakeIRCd::onCAP(Session &session, const std::vector<std::string> &parameters) {
+    if (parameters.empty())
+        return;
+    std::string subCommand = parameters[0];
+    std::transform(subCommand.begin(), subCommand.end(), subCommand.begin(), ::toupper);
+    std::string nick = session.nick.length() ? session.nick : "*";
+
+    if (subCommand == "LS") {
+        if (!session.registered)
+            session.capNegotiating = true;
+        std::string capabilities;
+        for (auto &capability : mConfig.capabilities)
+            capabilities += (capabilities.length() ? " " : "") + capability;
+        send(session, ":" + mConfig.serverName + " CAP " + nick + " LS :" + capabilities);
+    } else if (subCommand == "REQ" && parameters.size() > 1) {
+        StringTokenizer requested(parameters[1]);
+        bool supported = std::ranges::all_of(requested, [this](std::string_view capability) {
+            auto name = capability.starts_with('-') ? capability.substr(1) : capability;
+            return std::find(mConfig.capabilities.begin(), mConfig.capabilities.end(), name) != mConfig.capabilities.end();
+        });
+        if (supported) {
+            for (auto capability : requested) {
+                if (capability.starts_with('-'))
+                    session.capabilities.erase(std::string(capability.substr(1)));
+                else if (capability.length())
+                    session.capabilities.emplace(capability);
+            }
+        }
+        send(session, ":" + mConfig.serverName + " CAP " + nick + (supported ? " ACK :" : " NAK :") + parameters[1]);
+    } else if (subCommand == "END") {
+        session.capNegotiating = false;
+        onRegistered(session);
+    }
+}
+
+void FakeIRCd::onRegistered(Session &session) {
+    if (session.registered || session.capNegotiating || session.nick.empty() || session.user.empty())
+        return;
+    session.registered = true;
+
+    reply(session, "001", ":Welcome to the " + mConfig.network + " IRC Network " + session.source());
+    reply(session, "002", ":Your host is " + mConfig.serverName + ", running version FakeIRCd-1.0");
+    reply(session, "003", ":This server was created just now");
+    reply(session, "004", mConfig.serverName + " FakeIRCd-1.0 iowB beIiklmnopstv bkloIv");
+
+    // At most 13 tokens per ISUPPORT line
+    for (size_t i = 0; i < mConfig.isupport.size(); i += 13) {
+        std::string tokens;
+        for (size_t j = i; j < std::min(i + 13, mConfig.isupport.size()); j++)
+            tokens += mConfig.isupport[j] + " ";
+        reply(session, "005", tokens + ":are supported by this server");
+    }
+    reply(session, "422", ":MOTD File is missing");
+}
+
+void FakeIRCd::onJOIN(Session &session, const std::string &channels) {
+    for (auto token : StringTokenizer(channels, ",")) {
+        std::string name(token);
+        if (name.empty() || (name[0] != '#' && name[0] != '&')) {
+            reply(session, "403", name + " :No such channel");
+            continue;
+        }
+        bool created = !mChannels.contains(toLower(name));
+        auto &joined = channel(name);
+        if (joined.members.contains(&session))
+            continue;
+        if (created) {
+            // Synthetic members are only known by name
+            joined.topic = "Load test channel " + name;
+        }
+        joined.members.insert(&session);
+        session.channels.insert(toLower(name));
+
+        for (auto member : joined.members) {
+            if (member->capabilities.contains("extended-join"))
+                send(*member, ":" + session.source() + " JOIN " + joined.name + " * :" + session.realName);
+            else
+                send(*member, ":" + session.source() + " JOIN " + joined.name);
+        }
+        reply(session, "332", joined.name + " :" + joined.topic);
+        onNAMES(session, joined);
+    }
+}
+
+void FakeIRCd::onPART(Session &session, const std::string &channels) {
+    for (auto token : StringTokenizer(channels, ",")) {
+        std::string name(token);
+        auto it = mChannels.find(toLower(name));
+        if (it == mChannels.end() || !it->second.members.contains(&session)) {
+            reply(session, "442", name + " :You're not on that channel");
+            continue;
+        }
+        sendToChannel(it->second, ":" + session.source() + " PART " + it->second.name);
+        it->second.members.erase(&session);
+        session.channels.erase(it->first);
+    }
+}
+
+void FakeIRCd::onNAMES(Session &session, const Channel &channel) {
+    bool userhost = session.capabilities.contains("userhost-in-names");
+    std::string prefix = "= " + channel.name + " :";
+    std::string names;
+
+    auto add = [&](const std::string &name) {
+        // Keep the lines well within 512 bytes
+        if (names.length() + name.length() > 400) {
+            reply(session, "353", prefix + names);
+            names.clear();
+        }
+        names += (names.length() ? " " : "") + name;
+    };
+
+    for (auto member : channel.members)
+        add(userhost ? member->source() : member->nick);
+    for (unsigned i = 0; i < mConfig.membersPerChannel; i++) {
+        auto nick = syntheticMember(channel.name, i);
+        add(std::string(i % 10 ? "" : "@") + (userhost ? nick + "!" + nick + "@synthetic.fake.ircd" : nick));
+    }
+    if (names.length())
+        reply(session, "353", prefix + names);
+    reply(session, "366", channel.name + " :End of /NAMES list.");
+}
+
+void FakeIRCd::onWHO(Session &session, const std::vector<std::string> &parameters) {
+    auto mask = parameters[0];
+    auto it = mChannels.find(toLower(mask));
+
+    // WHOX: WHO <mask> %<fields>[,<token>]
+    std::string fields, token;
+    bool whox = parameters.size() > 1 && parameters[1].starts_with('%');
+    if (whox) {
+        auto comma = parameters[1].find(',');
+        fields = parameters[1].substr(1, comma - 1);
+        if (comma != std::string::npos)
+            token = parameters[1].substr(comma + 1);
+    }
+
+    auto who = [&](const std::string &nick, const std::string &user, const std::string &host, const std::string &flags,
+                   const std::string &account, const std::string &realName) {
+        if (!whox) {
+            reply(session, "352", mask + " " + user + " " + host + " " + mConfig.serverName + " " + nick + " " + flags +
+                                      " :0 " + realName);
+            return;
+        }
+        // The fields are returned in a fixed order, regardless of the order requested
+        std::string line;
+        for (char field : std::string("tcuihsnfdlaor")) {
+            if (fields.find(field) == std::string::npos)
+                continue;
+            switch (field) {
+            case 't':
+                line += " " + token;
+                break;
+            case 'c':
+                line += " " + (it != mChannels.end() ? it->second.name : std::string("*"));
+                break;
+            case 'u':
+                line += " " + user;
+                break;
+            case 'i':
+                line += " 127.0.0.1";
+                break;
+            case 'h':
+                line += " " + host;
+                break;
+            case 's':
+                line += " " + mConfig.serverName;
+                break;
+            case 'n':
+                line += " " + nick;
+                break;
+            case 'f':
+                line += " " + flags;
+                break;
+            case 'd':
+                line += " 0";
+                break;
+            case 'l':
+                line += " 0";
+                break;
+            case 'a':
+                line += " " + account;
+                break;
+            case 'o':
+                line += " n/a";
+                break;
+            case 'r':
+                line += " :" + realName;
+                break;
+            }
+        }
+        reply(session, "354", line.substr(1));
+    };
+
+    if (it != mChannels.end()) {
+        for (auto member : it->second.members)
+            who(member->nick, member->user, "127.0.0.1", "H", member->nick, member->realName);
+        for (unsigned i = 0; i < mConfig.membersPerChannel; i++) {
+            auto nick = syntheticMember(it->second.name, i);
+            who(nick, nick, "synthetic.fake.ircd", i % 10 ? "H" : "H@", i % 3 ? nick : "0", "Synthetic member " + nick);
+        }
+    } else if (auto target = findSession(mask)) {
+        who(target->nick, target->user, "127.0.0.1", "H", target->nick, target->realName);
+    }
+    reply(session, "315", mask + " :End of /WHO list.");
+}
+
+void FakeIRCd::onMessage(Session *from, const std::string &source, const std::string &command, const std::string &target,
+                         const std::string &text) {
+    std::string line = ":" + source + " " + command + " " + target + " :" + text;
+    bool echo = from && from->capabilities.contains("echo-message");
+
+    if (target.length() && (target[0] == '#' || target[0] == '&')) {
+        auto it = mChannels.find(toLower(target));
+        if (it == mChannels.end()) {
+            if (from)
+                reply(*from, "403", target + " :No such channel");
+            return;
+        }
+        sendToChannel(it->second, line, echo ? nullptr : from);
+    } else if (auto recipient = findSession(target)) {
+        send(*recipient, line);
+        if (echo && recipient != from)
+            send(*from, line);
+    } else if (from) {
+        reply(*from, "401", target + " :No such nick/channel");
+    }
+}
+
+void FakeIRCd::onQUIT(Session &session, const std::string &reason) {
+    if (session.registered) {
+        std::set<Session *> notified;
+        for (auto &name : session.channels) {
+            auto &channel = mChannels[name];
+            channel.members.erase(&session);
+            for (auto member : channel.members) {
+                if (notified.insert(member).second)
+                    send(*member, ":" + session.source() + " QUIT :" + reason);
+            }
+        }
+        session.channels.clear();
+    }
+    if (session.socket >= 0) {
+        send(session, "ERROR :Closing Link: " + reason);
+        flush(session);
+    }
+    close(session);
+}
+
+//----------------------------------------------------------------------------
+// Scripting
+//----------------------------------------------------------------------------
+void FakeIRCd::privmsg(const std::string &from, const std::string &target, const std::string &text) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        onMessage(nullptr, from, "PRIVMSG", target, text);
+    }
+    wakeup();
+}
+
+void FakeIRCd::notice(const std::string &from, const std::string &target, const std::string &text) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        onMessage(nullptr, from, "NOTICE", target, text);
+    }
+    wakeup();
+}
+
+void FakeIRCd::sendTo(const std::string &nick, const std::string &line) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (auto session = findSession(nick))
+            send(*session, line);
+    }
+    wakeup();
+}
+
+size_t FakeIRCd::clientCount(void) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSessions.size();
+}
+
+size_t FakeIRCd::registeredCount(void) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return std::count_if(mSessions.begin(), mSessions.end(), [](auto &session) { return session->registered; });
+}
+
+size_t FakeIRCd::channelCount(const std::string &nick) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto session = findSession(nick);
+    return session ? session->channels.size() : 0;
+}
+
+FakeIRCd::Statistics FakeIRCd::statistics(void) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStatistics;
+}
+
+} // namespace geblaat
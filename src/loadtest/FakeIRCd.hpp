@@ -0,0 +1,175 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef LOADTEST_FAKEIRCD_HPP_
+#define LOADTEST_FAKEIRCD_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "lineBuffer.hpp"
+
+namespace geblaat {
+
+// A small IRC server listening on the loopback interface, to drive the IRC
+// protocol through a normal TcpConnection without a live network.
+//
+// It speaks just enough IRC for that: CAP negotiation, registration with
+// ISUPPORT, JOIN, PART, NAMES, WHO and WHOX, PRIVMSG, NOTICE, PING and QUIT.
+// Every channel can be populated with synthetic members, which only exist in
+// NAMES and WHO replies and as the source of injected traffic.
+//
+// The server runs on its own thread. The public functions are thread safe,
+// and the line handler is called on the server thread.
+class FakeIRCd {
+  public:
+    struct Config {
+        std::string serverName = "fake.ircd";
+        std::string network = "FakeNet";
+        std::vector<std::string> capabilities = {"batch",       "echo-message",    "extended-join", "away-notify",
+                                                 "message-tags", "multi-prefix",   "server-time",   "userhost-in-names",
+                                                 "account-tag",  "account-notify", "labeled-response"};
+        std::vector<std::string> isupport = {"CASEMAPPING=rfc1459", "CHANTYPES=#&",  "CHANMODES=beI,k,l,imnpst",
+                                             "PREFIX=(ov)@+",       "MODES=4",       "NICKLEN=30",
+                                             "CHANNELLEN=64",       "TOPICLEN=307",  "LINELEN=512",
+                                             "BOT=B",               "WHOX",          "NETWORK=FakeNet"};
+        // Synthetic members added to every channel when it is created
+        unsigned membersPerChannel = 0;
+    };
+
+    // Called for every line received from a registered client, after the
+    // server handled it.
+    using LineHandler = std::function<void(const std::string &nick, std::string_view line)>;
+
+    explicit FakeIRCd(Config config);
+    FakeIRCd() : FakeIRCd(Config{}) {}
+    ~FakeIRCd();
+
+    // Listen on 127.0.0.1, on an ephemeral port if port is 0. Returns the port
+    // listened on, or 0 on failure.
+    uint16_t start(uint16_t port = 0);
+    void stop(void);
+
+    void setLineHandler(LineHandler handler);
+
+    // Scripting, with from as a full nick!user@host source
+    void privmsg(const std::string &from, const std::string &target, const std::string &text);
+    void notice(const std::string &from, const std::string &target, const std::string &text);
+    void sendTo(const std::string &nick, const std::string &line);
+
+    static std::string syntheticMember(const std::string &channel, unsigned index);
+
+    size_t clientCount(void);
+    size_t registeredCount(void);
+    // Number of channels the client has joined
+    size_t channelCount(const std::string &nick);
+
+    struct Statistics {
+        uint64_t linesReceived;
+        uint64_t linesSent;
+        uint64_t bytesReceived;
+        uint64_t bytesSent;
+    };
+    Statistics statistics(void);
+
+  private:
+    struct Session {
+        int socket = -1;
+        LineBuffer input;
+        std::string output;
+        std::string nick;
+        std::string user;
+        std::string realName;
+        bool capNegotiating = false;
+        bool registered = false;
+        std::set<std::string> capabilities;
+        std::set<std::string> channels;
+
+        std::string source(void) const { return nick + "!" + user + "@127.0.0.1"; }
+    };
+
+    struct Channel {
+        std::string name;
+        std::string topic;
+        std::set<Session *> members;
+    };
+
+    Config mConfig;
+    LineHandler mLineHandler;
+    std::vector<std::pair<std::string, std::string>> mHandled;
+
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<Session>> mSessions;
+    std::map<std::string, Channel, std::less<>> mChannels;
+    Statistics mStatistics = {};
+
+    int mListenSocket = -1;
+    int mWakeup[2] = {-1, -1};
+    std::atomic<bool> mRunning = false;
+    std::thread mThread;
+
+    void run(void);
+    void accept(void);
+    bool receive(Session &session);
+    bool flush(Session &session);
+    void close(Session &session);
+    void wakeup(void);
+
+    void onLine(Session &session, std::string_view line);
+    void onCAP(Session &session, const std::vector<std::string> &parameters);
+    void onRegistered(Session &session);
+    void onJOIN(Session &session, const std::string &channels);
+    void onPART(Session &session, const std::string &channels);
+    void onNAMES(Session &session, const Channel &channel);
+    void onWHO(Session &session, const std::vector<std::string> &parameters);
+    void onMessage(Session *from, const std::string &source, const std::string &command, const std::string &target,
+                   const std::string &text);
+    void onQUIT(Session &session, const std::string &reason);
+
+    Session *findSession(std::string_view nick);
+    Channel &channel(const std::string &name);
+    void reply(Session &session, std::string_view numeric, const std::string &text);
+    void send(Session &session, const std::string &line);
+    void sendToChannel(Channel &channel, const std::string &line, Session *except = nullptr);
+
+    static std::vector<std::string> parse(std::string_view line, std::string &command);
+    static std::string toLower(std::string_view str);
+};
+
+} // namespace geblaat
+
+#endif /* LOADTEST_FAKEIRCD_HPP_ */
@@ -0,0 +1,337 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+// End-to-end load test: runs a number of bots against a FakeIRCd on the
+// loopback interface, sends bot commands and background traffic at the
+// requested rates, and reports the command to reply latency, throughput and
+// memory use. The bots are loaded through the PluginLoader, exactly as the
+// blaatbot2025 executable does, so they use the normal TcpConnection.
+//
+// The bots log to stdout, the report is written to stderr.
+
+// C++ Library Includes
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Library Includes
+#include <cxxopts.hpp>
+#include <nlohmann/json.hpp>
+
+#include "FakeIRCd.hpp"
+#include "PluginLoader.hpp"
+#include "clients/Client.hpp"
+#include "logger.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    unsigned bots = 4;
+    unsigned channels = 10;      // per bot
+    unsigned members = 20;       // synthetic members per channel
+    unsigned commandRate = 50;   // bot commands per second
+    unsigned noiseRate = 500;    // other channel messages per second
+    unsigned duration = 10;      // seconds
+    unsigned syncTimeout = 60;   // seconds
+    std::string command = "!blaat";
+};
+
+static int parse_options(int argc, char *argv[], Options &opt) {
+    try {
+        cxxopts::Options options(*argv, "BlaatBot2025 load test");
+
+        // clang-format off
+        options.add_options()
+            ("b,bots", "Number of bots", cxxopts::value<unsigned>()->default_value(std::to_string(opt.bots)))
+            ("c,channels", "Channels joined by every bot", cxxopts::value<unsigned>()->default_value(std::to_string(opt.channels)))
+            ("m,members", "Synthetic members per channel", cxxopts::value<unsigned>()->default_value(std::to_string(opt.members)))
+            ("r,rate", "Bot commands per second", cxxopts::value<unsigned>()->default_value(std::to_string(opt.commandRate)))
+            ("n,noise", "Other channel messages per second", cxxopts::value<unsigned>()->default_value(std::to_string(opt.noiseRate)))
+            ("d,duration", "Duration of the measurement in seconds", cxxopts::value<unsigned>()->default_value(std::to_string(opt.duration)))
+            ("t,sync-timeout", "Seconds to wait for the bots to join", cxxopts::value<unsigned>()->default_value(std::to_string(opt.syncTimeout)))
+            ("command", "Bot command to send", cxxopts::value<std::string>()->default_value(opt.command))
+            ("h,help", "Display help");
+        // clang-format on
+
+        auto result = options.parse(argc, argv);
+        if (result.count("help")) {
+            std::cout << options.help();
+            return 1;
+        }
+        opt.bots = result["bots"].as<unsigned>();
+        opt.channels = result["channels"].as<unsigned>();
+        opt.members = result["members"].as<unsigned>();
+        opt.commandRate = result["rate"].as<unsigned>();
+        opt.noiseRate = result["noise"].as<unsigned>();
+        opt.duration = result["duration"].as<unsigned>();
+        opt.syncTimeout = result["sync-timeout"].as<unsigned>();
+        opt.command = result["command"].as<std::string>();
+        return 0;
+    } catch (const cxxopts::exceptions::exception &ex) {
+        std::cerr << "Failed to parse command line options" << std::endl;
+        std::cerr << ex.what() << std::endl;
+        return -1;
+    }
+}
+
+// Memory use of the whole process, in KiB, from /proc/self/status
+static unsigned long memoryUse(const std::string &key) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with(key + ":"))
+            return std::stoul(line.substr(key.length() + 1));
+    }
+    return 0;
+}
+
+static std::string botNick(unsigned bot) { return "loadbot" + std::to_string(bot); }
+static std::string channelName(unsigned bot, unsigned channel) {
+    return "#load" + std::to_string(bot) + "-" + std::to_string(channel);
+}
+
+// Pairs the commands sent to a bot in a channel with the replies of that bot
+class LatencyTracker {
+  public:
+    void sent(const std::string &nick, const std::string &channel, Clock::time_point time) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPending[{nick, channel}].push_back(time);
+        mSent++;
+    }
+
+    void replied(const std::string &nick, const std::string &channel, Clock::time_point time) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mPending.find({nick, channel});
+        if (it == mPending.end() || it->second.empty()) {
+            mUnexpected++;
+            return;
+        }
+        mLatencies.push_back(std::chrono::duration<double, std::micro>(time - it->second.front()).count());
+        it->second.pop_front();
+    }
+
+    size_t outstanding(void) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mSent - mLatencies.size();
+    }
+
+    struct Report {
+        size_t sent, replied, unexpected;
+        double p50, p90, p99, max, mean;
+    };
+
+    Report report(void) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Report r = {mSent, mLatencies.size(), mUnexpected, 0, 0, 0, 0, 0};
+        if (mLatencies.empty())
+            return r;
+        auto sorted = mLatencies;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](double p) { return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))]; };
+        r.p50 = percentile(0.50);
+        r.p90 = percentile(0.90);
+        r.p99 = percentile(0.99);
+        r.max = sorted.back();
+        for (auto latency : sorted)
+            r.mean += latency;
+        r.mean /= sorted.size();
+        return r;
+    }
+
+  private:
+    std::mutex mMutex;
+    std::map<std::pair<std::string, std::string>, std::deque<Clock::time_point>> mPending;
+    std::vector<double> mLatencies;
+    size_t mSent = 0;
+    size_t mUnexpected = 0;
+};
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (int result = parse_options(argc, argv, options))
+        return result < 0 ? result : 0;
+
+    auto memoryStart = memoryUse("VmRSS");
+
+    geblaat::FakeIRCd::Config serverConfig;
+    serverConfig.membersPerChannel = options.members;
+    geblaat::FakeIRCd server(serverConfig);
+    auto port = server.start();
+    if (!port)
+        return -1;
+
+    // Replies to a command are CTCP ACTIONs sent to the channel
+    LatencyTracker tracker;
+    server.setLineHandler([&tracker](const std::string &nick, std::string_view line) {
+        auto now = Clock::now();
+        if (!line.starts_with("PRIVMSG "))
+            return;
+        auto target = line.substr(8, line.find(' ', 8) - 8);
+        if (line.find(" :\001ACTION ") != std::string_view::npos)
+            tracker.replied(nick, std::string(target), now);
+    });
+
+    //------------------------------------------------------------------------
+    // Start the bots
+    //------------------------------------------------------------------------
+    geblaat::PluginLoader pluginLoader;
+    std::vector<geblaat::Client *> clients;
+    auto syncStart = Clock::now();
+    for (unsigned bot = 0; bot < options.bots; bot++) {
+        nlohmann::json autojoin = nlohmann::json::array();
+        for (unsigned channel = 0; channel < options.channels; channel++)
+            autojoin.push_back({{"channel", channelName(bot, channel)}});
+
+        nlohmann::json config = {
+            {"networks",
+             {{{"network", "FakeNet"},
+               {"protocol",
+                {{"name", "irc"},
+                 {"config",
+                  {{"username", "loadbot"},
+                   {"nickname", botNick(bot)},
+                   {"realname", "geblaat load test"},
+                   {"autojoin", autojoin},
+                   {"connections", {{{"name", "tcp"}, {"config", {{"hostname", "127.0.0.1"}, {"port", port}}}}}}}}}}}}},
+            {"modules", nlohmann::json::array()}};
+
+        auto client = dynamic_cast<geblaat::Client *>(pluginLoader.newInstance("bot", "client"));
+        if (!client) {
+            LOG_ERROR("Unable to get a client");
+            return -1;
+        }
+        client->setConfig(config);
+        clients.push_back(client);
+    }
+
+    // Synchronised once every bot has joined all of its channels
+    bool synchronised = false;
+    while (Clock::now() - syncStart < std::chrono::seconds(options.syncTimeout)) {
+        synchronised = true;
+        for (unsigned bot = 0; bot < options.bots && synchronised; bot++)
+            synchronised = server.channelCount(botNick(bot)) == options.channels;
+        if (synchronised)
+            break;
+        std::this_thread::sleep_for(10ms);
+    }
+    auto syncTime = std::chrono::duration<double>(Clock::now() - syncStart).count();
+    if (!synchronised)
+        LOG_WARNING("Not all bots joined their channels within %u seconds", options.syncTimeout);
+    // Leave time for the WHO replies to be processed
+    std::this_thread::sleep_for(500ms);
+    auto memorySynchronised = memoryUse("VmRSS");
+    auto statisticsStart = server.statistics();
+
+    //------------------------------------------------------------------------
+    // Traffic
+    //------------------------------------------------------------------------
+    std::mt19937 random(2025);
+    std::uniform_int_distribution<unsigned> pickBot(0, options.bots - 1);
+    std::uniform_int_distribution<unsigned> pickChannel(0, std::max(options.channels, 1u) - 1);
+    std::uniform_int_distribution<unsigned> pickMember(0, std::max(options.members, 1u) - 1);
+
+    const std::string driver = "driver!driver@load.test";
+    const char *noise[] = {"hello everyone", "\00304colours\003 and \002bold\002 text",
+                           "a somewhat longer line of text, as people tend to type when they discuss something",
+                           "ünïcödé tëxt ☺", "!notacommand with parameters"};
+
+    auto measurementStart = Clock::now();
+    auto measurementEnd = measurementStart + std::chrono::seconds(options.duration);
+    auto commandInterval = std::chrono::nanoseconds(1s) / std::max(options.commandRate, 1u);
+    auto noiseInterval = std::chrono::nanoseconds(1s) / std::max(options.noiseRate, 1u);
+    auto nextCommand = options.commandRate ? measurementStart : measurementEnd;
+    auto nextNoise = options.noiseRate ? measurementStart : measurementEnd;
+    uint64_t noiseSent = 0;
+
+    if (options.channels) {
+        while (true) {
+            auto next = std::min(nextCommand, nextNoise);
+            if (next >= measurementEnd)
+                break;
+            std::this_thread::sleep_until(next);
+
+            unsigned bot = pickBot(random);
+            auto channel = channelName(bot, pickChannel(random));
+            if (nextCommand <= nextNoise) {
+                tracker.sent(botNick(bot), channel, Clock::now());
+                server.privmsg(driver, channel, options.command);
+                nextCommand += commandInterval;
+            } else {
+                std::string from = "noise!noise@synthetic.fake.ircd";
+                if (options.members) {
+                    auto member = geblaat::FakeIRCd::syntheticMember(channel, pickMember(random));
+                    from = member + "!" + member + "@synthetic.fake.ircd";
+                }
+                server.privmsg(from, channel, noise[noiseSent++ % std::size(noise)]);
+                nextNoise += noiseInterval;
+            }
+        }
+    }
+
+    // Allow the outstanding replies to arrive
+    auto drainEnd = Clock::now() + 2s;
+    while (tracker.outstanding() && Clock::now() < drainEnd)
+        std::this_thread::sleep_for(10ms);
+    auto measurementTime = std::chrono::duration<double>(Clock::now() - measurementStart).count();
+    auto statisticsEnd = server.statistics();
+    auto memoryEnd = memoryUse("VmRSS");
+    auto memoryPeak = memoryUse("VmHWM");
+
+    for (auto client : clients)
+        delete client;
+    server.stop();
+
+    //------------------------------------------------------------------------
+    // Report
+    //------------------------------------------------------------------------
+    auto latency = tracker.report();
+    fprintf(stderr, "\n");
+    fprintf(stderr, "bots                %u, %u channels each, %u synthetic members per channel\n", options.bots,
+            options.channels, options.members);
+    fprintf(stderr, "sync                %.3f s%s\n", syncTime, synchronised ? "" : " (incomplete)");
+    fprintf(stderr, "commands            %zu sent, %zu replied, %zu lost, %zu unexpected replies\n", latency.sent,
+            latency.replied, latency.sent - latency.replied, latency.unexpected);
+    fprintf(stderr, "latency             p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us, mean %.1f us\n", latency.p50,
+            latency.p90, latency.p99, latency.max, latency.mean);
+    fprintf(stderr, "throughput          %.0f replies/s, %.0f lines/s to the bots, %.0f lines/s from the bots\n",
+            latency.replied / measurementTime, (statisticsEnd.linesSent - statisticsStart.linesSent) / measurementTime,
+            (statisticsEnd.linesReceived - statisticsStart.linesReceived) / measurementTime);
+    fprintf(stderr, "memory              %lu KiB at start, %lu KiB synchronised, %lu KiB at end, %lu KiB peak\n",
+            memoryStart, memorySynchronised, memoryEnd, memoryPeak);
+
+    return latency.sent == latency.replied ? 0 : 1;
+}
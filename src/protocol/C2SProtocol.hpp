@@ -30,11 +30,13 @@
 
 // C++ Includes
 #include <memory>
+#include <string_view>
 #include <vector>
 
 // Third Party libraries
 #include <nlohmann/json.hpp>
 
+#include "ChannelSnapshot.hpp"
 #include "PluginLoadable.hpp"
 #include "Protocol.hpp"
 
@@ -51,6 +53,19 @@ class C2SProtocol : public PluginLoadable, public Protocol {
 
     virtual void sendMessage(std::map<std::string, std::string> message) = 0;
 
+    // Requests events the protocol would otherwise not pass to the client.
+    // The event names are specific to the protocol.
+    virtual void subscribe(const std::string &) {}
+
+    // The channels we are in, safe to call from any thread. Returns nullptr
+    // when the protocol does not track them, or nothing was published yet.
+    virtual std::shared_ptr<const ChannelSnapshots> channels(void) { return nullptr; }
+
+    // The text of the message being passed to the client, rendered on
+    // demand as "plain", "irc", "ansi" or "html". Only valid from within
+    // Client::onMessage, empty when the message has no text.
+    virtual std::string_view text(std::string_view /*format*/) { return {}; }
+
   protected:
     Client *mClient = nullptr;
 };
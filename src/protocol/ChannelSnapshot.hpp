@@ -0,0 +1,125 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef PROTOCOL_CHANNELSNAPSHOT_HPP_
+#define PROTOCOL_CHANNELSNAPSHOT_HPP_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace geblaat {
+
+// Immutable views of the channels of a connection, for readers on any
+// thread. The protocol thread publishes a new ChannelSnapshots after it has
+// processed received data, when something changed. A reader takes the
+// current one and keeps a consistent view for as long as it holds on to it.
+//
+// Nothing is copied that did not change: users are shared by the channels
+// they are in, and channels are spread over shards, so a change to one
+// channel only copies its shard.
+
+struct UserSnapshot {
+    std::string nick;
+    std::string user;
+    std::string host;
+    // Empty when not logged in, or when that is not known
+    std::string account;
+    std::string realname;
+};
+
+struct ChannelSnapshot {
+    struct Member {
+        std::shared_ptr<const UserSnapshot> user;
+        // Like "@+", highest rank first
+        std::string prefixes;
+    };
+
+    std::string name;
+    std::string topic;
+    // The modes without a parameter, like "nt"
+    std::string modes;
+    // The modes with a parameter, like the key and limit
+    std::vector<std::pair<char, std::string>> settings;
+    std::vector<Member> members;
+};
+
+struct ChannelSnapshots {
+    static constexpr size_t shardCount = 64;
+    using Shard = std::map<std::string, std::shared_ptr<const ChannelSnapshot>, std::less<>>;
+
+    // Keyed by the name folded with the casemapping of the network
+    std::array<std::shared_ptr<const Shard>, shardCount> shards;
+    // The byte fold of that casemapping
+    std::array<char, 256> fold;
+    // With UTF8MAPPING, folds names that are not ASCII further after the
+    // byte fold. Not set when the network or the build does not apply it.
+    void (*utf8Fold)(std::string &key) = nullptr;
+
+    std::string key(std::string_view name) const {
+        std::string key(name);
+        bool ascii = true;
+        for (auto &c : key) {
+            ascii &= (unsigned char)c < 0x80;
+            c = fold[(unsigned char)c];
+        }
+        if (utf8Fold && !ascii)
+            utf8Fold(key);
+        return key;
+    }
+    static size_t shardOf(std::string_view key) { return std::hash<std::string_view>{}(key) % shardCount; }
+
+    // Looks up a channel by name in any case, nullptr when we are not in it
+    std::shared_ptr<const ChannelSnapshot> find(std::string_view name) const {
+        auto key = this->key(name);
+        auto &shard = shards[shardOf(key)];
+        if (!shard)
+            return nullptr;
+        auto it = shard->find(key);
+        return it != shard->end() ? it->second : nullptr;
+    }
+
+    template <typename F> void forEach(F f) const {
+        for (auto &shard : shards) {
+            if (shard) {
+                for (auto &channel : *shard)
+                    f(*channel.second);
+            }
+        }
+    }
+};
+
+} // namespace geblaat
+
+#endif /* PROTOCOL_CHANNELSNAPSHOT_HPP_ */
@@ -30,13 +30,14 @@
 
 #include "splitString.hpp"
 #include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
-#include <random>
 #include <sstream>
 #include <string>
+#include <utility>
 
 #ifdef ENABLE_ICU
 // Note: Look at libunistring in stead of libicu
@@ -101,6 +102,13 @@ IRC::IRC() {
     mMessageParsers[Numeric::RPL_YOURHOST] = [this](IRCMessage &message) { onYourHost(message); };
 
     mMessageParsers["JOIN"] = [this](IRCMessage &message) { onJOIN(message); };
+    mMessageParsers["PART"] = [this](IRCMessage &message) { onPART(message); };
+    mMessageParsers["KICK"] = [this](IRCMessage &message) { onKICK(message); };
+    mMessageParsers["QUIT"] = [this](IRCMessage &message) { onQUIT(message); };
+    mMessageParsers["ACCOUNT"] = [this](IRCMessage &message) { onACCOUNT(message); };
+    mMessageParsers["NICK"] = [this](IRCMessage &message) { onNICK(message); };
+    mMessageParsers["CHGHOST"] = [this](IRCMessage &message) { onCHGHOST(message); };
+    mMessageParsers[Numeric::RPL_VISIBLEHOST] = [this](IRCMessage &message) { onVisibleHost(message); };
     mMessageParsers["MODE"] = [this](IRCMessage &message) { onMODE(message); };
     mMessageParsers[Numeric::RPL_CHANNELMODEIS] = [this](IRCMessage &message) { onChannelModeIs(message); };
 
@@ -112,11 +120,48 @@ IRC::IRC() {
     mMessageParsers[Numeric::RPL_WHOREPLY] = [this](IRCMessage &message) { onWhoReply(message); };
     mMessageParsers[Numeric::RPL_WHOSPCRPL] = [this](IRCMessage &message) { onWhoSpcReply(message); };
     mMessageParsers[Numeric::RPL_ENDOFWHO] = [this](IRCMessage &message) { onEndOfWho(message); };
+
+    mMessageParsers["BATCH"] = [this](IRCMessage &message) { onBATCH(message); };
     //
     //
+    updateInterest();
+}
+
+IRC::IRCMessageParser &IRC::MessageParsers::operator[](std::string_view command) {
+    auto code = IRCCommand::decode(command);
+    if (code == IRCCommand::unknown) {
+        LOG_ERROR("Cannot register a handler for %.*s, it is not in the command table", (int)command.length(), command.data());
+        mRefused = nullptr;
+        return mRefused;
+    }
+    return mParsers[code];
+}
+
+void IRC::updateInterest(void) {
+    mInterest = mSubscriptions;
+    for (IRCCommand::Code code = 0; code < IRCCommand::count; code++) {
+        if (mMessageParsers.contains(code))
+            mInterest.set(code);
+    }
+}
+
+void IRC::subscribe(const std::string &command) {
+    auto code = IRCCommand::decode(command);
+    if (code == IRCCommand::unknown) {
+        LOG_WARNING("Cannot subscribe to unknown command %s", command.c_str());
+        return;
+    }
+    mSubscriptions.set(code);
+    updateInterest();
 }
 
 IRC::~IRC() {
+    {
+        // The WHO timer does not arm itself again after this
+        std::lock_guard<std::recursive_mutex> lock(mMutex);
+        mClosing = true;
+    }
+    whoTimer.abortTimer();
     // TODO Auto-generated destructor stub
     lagTimer.abortTimer();
     connectTimer.abortTimer();
@@ -126,6 +171,36 @@ IRC::~IRC() {
         send("QUIT exited");
 }
 
+void IRC::textToClient(std::map<std::string, std::string> &m, FormattedText &text) {
+    if (!mClient)
+        return;
+    if (mRenderPlain)
+        m["text/plain"] = text.plain();
+    if (mRenderIRC)
+        m["text/irc"] = text.irc();
+    if (mRenderANSI)
+        m["text/ansi"] = text.ansi();
+    if (mRenderHTML)
+        m["text/html"] = text.html();
+    auto previous = std::exchange(mText, &text);
+    mClient->onMessage(m);
+    mText = previous;
+}
+
+std::string_view IRC::text(std::string_view format) {
+    if (!mText)
+        return {};
+    if (format == "plain")
+        return mText->plain();
+    if (format == "irc")
+        return mText->irc();
+    if (format == "ansi")
+        return mText->ansi();
+    if (format == "html")
+        return mText->html();
+    return {};
+}
+
 int IRC::setConfig(const nlohmann::json &cfg) {
     try {
         config = cfg;
@@ -141,6 +216,7 @@ int IRC::setConfig(const nlohmann::json &cfg) {
         } else {
             mNick = "geblaat";
         }
+        publishTextBudget();
 
         if (config.contains("password") && config["password"].is_string()) {
             mPass = config["password"];
@@ -154,6 +230,43 @@ int IRC::setConfig(const nlohmann::json &cfg) {
             mRealName = "Geblaat (BlaatBot2025)";
         }
 
+        // Renderings of formatted text to add to every message, eg.
+        // "formats" : [ "plain", "irc", "ansi", "html" ]. Clients that only
+        // look at some messages render those through text().
+        mRenderPlain = mRenderIRC = mRenderANSI = mRenderHTML = false;
+        if (config.contains("formats") && config["formats"].is_array()) {
+            for (auto &format : config["formats"]) {
+                if (format == "plain")
+                    mRenderPlain = true;
+                else if (format == "irc")
+                    mRenderIRC = true;
+                else if (format == "ansi")
+                    mRenderANSI = true;
+                else if (format == "html")
+                    mRenderHTML = true;
+                else
+                    LOG_WARNING("Unknown format %s", format.dump().c_str());
+            }
+        }
+
+        // WHO requests after joining, eg. "who" : { "inflight" : 1,
+        // "interval" : 500, "priority" : [ "#channel" ] }, interval in ms
+        mWhoInFlightLimit = 1;
+        mWhoInterval = std::chrono::milliseconds(500);
+        mWhoPriority.clear();
+        if (config.contains("who") && config["who"].is_object()) {
+            auto &who = config["who"];
+            if (who.contains("inflight") && who["inflight"].is_number_unsigned() && who["inflight"] > 0)
+                mWhoInFlightLimit = who["inflight"];
+            if (who.contains("interval") && who["interval"].is_number_unsigned())
+                mWhoInterval = std::chrono::milliseconds(who["interval"].get<unsigned>());
+            if (who.contains("priority") && who["priority"].is_array()) {
+                for (auto &channel : who["priority"])
+                    if (channel.is_string())
+                        mWhoPriority.push_back(channel);
+            }
+        }
+
         if (config.contains("autojoin") && config["autojoin"].is_array()) {
             for (auto &join : config["autojoin"]) {
                 AutoJoinChannel channel = {};
@@ -198,189 +311,476 @@ int IRC::setConfig(const nlohmann::json &cfg) {
     return 0;
 }
 
-std::string IRC::toLower(std::string s) {
-    /*
-     The value MUST be specified and is a string. Servers MAY advertise
-     alternate casemappings to those above, but clients MAY NOT be able to
-     understand or perform them. If the parameter is not published by the
-     server at all, clients SHOULD assume CASEMAPPING=rfc1459.
-     */
-    std::string caseMapping = "rfc1459";
-    if (serverInfo.features.count("CASEMAPPING"))
-        caseMapping = serverInfo.features["CASEMAPPING"];
+// Compiles the casemapping, whenever the ISUPPORT tokens it depends on may
+// have changed
+void IRC::configureCaseMapping(void) {
+    auto caseMapping = serverInfo.features.find("CASEMAPPING");
+    auto utf8Mapping = serverInfo.features.find("UTF8MAPPING");
+    auto previousType = mCaseMapping.type();
+    auto previousUtf8 = mCaseMapping.utf8();
+    mCaseMapping.configure(caseMapping != serverInfo.features.end() ? caseMapping->second : "",
+                           utf8Mapping != serverInfo.features.end());
+    mFoldCache.clear();
+    if (utf8Mapping != serverInfo.features.end()) {
+        LOG_DEBUG("UTF8MAPPING: %s", utf8Mapping->second.c_str());
+    }
+#ifndef ENABLE_ICU
+    if (mCaseMapping.utf8())
+        LOG_INFO("UTF8 Mapping has been disabled");
+#endif
 
-    bool utf8Mapping = false;
-    if (serverInfo.features.count("UTF8MAPPING")) {
+    // The symbols are hashed with the previous mapping. Normally ISUPPORT
+    // arrives before we join anything, so this is rare.
+    if ((previousType != mCaseMapping.type() || previousUtf8 != mCaseMapping.utf8()) && mSymbols.size()) {
+        if (mCaseMapping.utf8() && !previousUtf8) {
+            // Names are interned folded with the UTF8 mapping
+            for (auto &channel : ircChannels)
+                mSymbols.rename(channel.first, toLower(mSymbols.name(channel.first)));
+            for (auto &user : ircUsers)
+                mSymbols.rename(user.first, toLower(mSymbols.name(user.first)));
+        }
+        mSymbols.rehash();
+        // The snapshots are keyed with the mapping
+        mRepublish = true;
+    }
 
-        LOG_DEBUG("UTF8MAPPING: %s", serverInfo.features["UTF8MAPPING"].c_str());
+    // Let the client compare names the same way, for instance for its
+    // ignore list
+    if ((previousType != mCaseMapping.type() || previousUtf8 != mCaseMapping.utf8()) && mClient) {
+        std::map<std::string, std::string> m;
+        m["type"] = "casemapping";
+        m["casemapping"] = caseMapping != serverInfo.features.end() ? caseMapping->second : "rfc1459";
+        if (utf8Mapping != serverInfo.features.end())
+            m["casemapping/utf8"] = utf8Mapping->second;
+        mClient->onMessage(m);
+    }
+}
 
-        // See also
-        // https://github.com/DanielOaks/ircv3-specifications/blob/master+rfc7700/documentation/rfc8265.md
-        // suggesting
+#ifdef ENABLE_ICU
+// The NFC normalizer is a singleton owned by ICU, look it up only once
+static const icu::Normalizer2 *nfcNormalizer(void) {
+    static const icu::Normalizer2 *normalizer = [] {
+        UErrorCode errorCode = U_ZERO_ERROR;
+        auto normalizer = icu::Normalizer2::getNFCInstance(errorCode);
+        if (U_FAILURE(errorCode)) {
+            LOG_ERROR("Unable to obtain the NFC normalizer: %s", u_errorName(errorCode));
+            return (const icu::Normalizer2 *)nullptr;
+        }
+        return normalizer;
+    }();
+    return normalizer;
+}
+#endif
 
-        // CASEMAPPING=ascii UTF8MAPPING=rfc8265
+#ifdef ENABLE_ICU
+// The UTF8 case mapping of a name the byte fold has been applied to. It
+// keeps no state, so the snapshots use it from any thread.
+static void utf8Fold(std::string &s) {
+    // rfc7613 mentions "Unicode Default Case Folding as defined in
+    // the Unicode Standard", which appears to be implemented by the ICU library
+    // Should we use that library?
 
-        // https://github.com/ircv3/ircv3-specifications/pull/272/commits/807e084fba9634084054def193424b9589f2a56b
-        // https://github.com/DanielOaks/ircv3-specifications/blob/master%2Brfc7700/documentation/rfc8265.md
+    // Please note: There appears to be StringPrep support
+    // which is RFC 3454.
+    // RFC 7564 (PRECIS) obsoletes RFC 3454.
+    // However, if we got an RFC 3454 implementation,
+    // RFC 8265 (Obsoletes 7613) mentions previous approach was
+    // SASLPrep (RFC 4013)
+    // Seems it does the BiDi thing? But preserves case?
 
-        // Changed casemapping from "rfc7700" to "rfc7613", to match new draft spec.
-        // The recommended value of `server.casemapping` is now `ascii` instead of
-        // `precis`.
+    // https://datatracker.ietf.org/doc/html/rfc8265#section-3.3
 
-        // rfc7613 mentioned in https://modern.ircdocs.horse/
-        // rfc3454 mentioned in https://defs.ircdocs.horse/defs/isupport
+    // However, I think the most important parts are covered, for now.
 
-        // Many possible values for utf8 mapping, for now, we only have one
-        // casemapping case for utf8
-        utf8Mapping = true;
-    }
+    // Convert string to icu's datatype
+    // (fromUTF8 is a factory, it does not assign to an existing object)
+    icu::UnicodeString u = icu::UnicodeString::fromUTF8(s);
 
-    // As some point, it was decided, when UTF8 case mapping is in use, rather
-    // then putting some RFC in the casemapping, put ascii and create a new
-    // UTF8MAPPING feature. However, older specs mention some values in
-    // casemapping to indicate UTF8 mapping
-    // *  rfc7613 mentioned in https://modern.ircdocs.horse/
-    // *  rfc3454 mentioned in https://defs.ircdocs.horse/defs/isupport
-    // If we encounter such, we use the, to my knowledge, latest approach:
-    // First apply ASCII mapping, then apply UTF mapping.
-    if ((caseMapping == "rfc3454") || (caseMapping == "rfc7700") || (caseMapping == "rfc7613") || (caseMapping == "rfc8265") ||
-        (caseMapping == "precis") || (caseMapping == "utf8")) {
-        caseMapping = "ascii";
-        utf8Mapping = true;
-    }
+    //    1.  Width Mapping Rule: Map fullwidth and halfwidth code points to
+    //        their decomposition mappings (see Unicode Standard Annex #11
+    //        [UAX11]).
 
-    if (caseMapping == "ascii") {
-        // ascii: Defines the characters a to z to be considered the lower-case
-        // equivalents of the characters A to Z only.
+    // I have trouble finding the calls into ICU for the first step.
+    // Case mapping and normalisation, that looks ok
 
-        // https://datatracker.ietf.org/doc/html/draft-hardy-irc-isupport-00#section-4.1
-        // "ascii": The ASCII characters 97 to 122 (decimal) are defined as
-        // the lower-case characters of ASCII 65 to 90 (decimal).  No other
-        // character equivalency is defined.
+    //    2.  Additional Mapping Rule: There is no additional mapping rule.
 
-        for (unsigned int i = 0; i < s.length(); i++) {
-            if (s[i] >= 65 && s[i] <= 90)
-                s[i] += 32;
-        }
+    // Trivial ;)
 
-    } else if (caseMapping == "rfc1459") {
-        // rfc1459: Same as 'ascii', with the addition of the characters
-        // '{', '}', '|', and '^' being considered the lower-case equivalents
-        // of the characters '[', ']', '\', and '~' respectively.
+    //    3.  Case Mapping Rule: Map uppercase and titlecase code points to
+    //        their lowercase equivalents, preferably using the Unicode
+    //        toLowerCase() operation as defined in the Unicode Standard
+    //        [Unicode]; see further discussion in Section 3.2.
 
-        // https://datatracker.ietf.org/doc/html/draft-hardy-irc-isupport-00#section-4.1
-        // "rfc1459": The ASCII characters 97 to 126 (decimal) are defined as
-        // the lower-case characters of ASCII 65 to 94 (decimal).  No other
-        // character equivalency is defined.
+    u.toLower();
 
-        for (unsigned int i = 0; i < s.length(); i++) {
-            if (s[i] >= 65 && s[i] <= 94)
-                s[i] += 32;
-        }
+    //    4.  Normalization Rule: Apply Unicode Normalization Form C (NFC) to
+    //        all strings.
 
-    } else if (caseMapping == "rfc1459-strict") {
-        // rfc1459-strict: Same casemapping as 'ascii', with the characters
-        // '{', '}', and '|' being the lower-case equivalents of
-        // '[', ']', and '\', respectively. Note that the difference between
-        // this and rfc1459 above is that in rfc1459-strict, '^' and '~' are not
-        // casefolded.
+    if (auto normalizer = nfcNormalizer()) {
+        UErrorCode errorCode = U_ZERO_ERROR;
+        icu::UnicodeString normalized = normalizer->normalize(u, errorCode);
+        if (U_SUCCESS(errorCode))
+            u = std::move(normalized);
+        else
+            LOG_WARNING("Normalisation failed: %s", u_errorName(errorCode));
+    }
 
-        // https://datatracker.ietf.org/doc/html/draft-hardy-irc-isupport-00#section-4.1
-        // "strict-rfc1459": The ASCII characters 97 to 125 (decimal) are
-        // defined as the lower-case characters of ASCII 65 to 93 (decimal).
-        // no other character equivalency is defined.
+    //    5.  Directionality Rule: Apply the "Bidi Rule" defined in [RFC5893]
+    //        to strings that contain right-to-left code points (i.e., each of
+    //        the six conditions of the Bidi Rule must be satisfied); for
+    //        strings that do not contain right-to-left code points, there is
+    //        no special processing for directionality.
 
-        for (unsigned int i = 0; i < s.length(); i++) {
-            if (s[i] >= 65 && s[i] <= 93)
-                s[i] += 32;
-        }
+    // There is some bidi functionality in the ICU library, but I do not
+    // understand how any of that maps to any of the rules.
 
-    } else {
-        // Unknown case mapping? What should we do in this case?
-        // Safe to assume at least ASCII should map?
-        for (unsigned int i = 0; i < s.length(); i++) {
-            if (s[i] >= 65 && s[i] <= 90)
-                s[i] += 32;
-        }
-    }
+    // Processing done: Convert it back to a std::string
+    // (toUTF8String appends)
+    s.clear();
+    u.toUTF8String(s);
+}
+#endif
+
+std::string IRC::toLower(std::string_view str) {
+    std::string s;
 #ifdef ENABLE_ICU
-    if (utf8Mapping) {
-        // UTF8 case mapping
+    if (mCaseMapping.utf8() && !CaseMapping::isAscii(str)) {
+        if (auto cached = mFoldCache.find(str))
+            return *cached;
+        mCaseMapping.fold(str, s);
+        utf8Fold(s);
+        mFoldCache.insert(str, s);
+        return s;
+    }
+#endif
+    // The UTF8 mapping leaves ASCII as it is
+    mCaseMapping.fold(str, s);
+    return s;
+}
 
-        // rfc7613 mentions "Unicode Default Case Folding as defined in
-        // the Unicode Standard", which appears to be implemented by the ICU library
-        // Should we use that library?
+bool IRC::isEqual(std::string_view first, std::string_view seccond) {
+    // The byte mappings compare in place, without allocating
+    if (!mCaseMapping.utf8())
+        return mCaseMapping.equals(first, seccond);
 
-        // Please note: There appears to be StringPrep support
-        // which is RFC 3454.
-        // RFC 7564 (PRECIS) obsoletes RFC 3454.
-        // However, if we got an RFC 3454 implementation,
-        // RFC 8265 (Obsoletes 7613) mentions previous approach was
-        // SASLPrep (RFC 4013)
-        // Seems it does the BiDi thing? But preserves case?
+    // If the length differ, then they are not equal, we don't have to
+    // look further.
+    if (first.length() != seccond.length())
+        return false;
+    return toLower(first) == toLower(seccond);
+}
 
-        // https://datatracker.ietf.org/doc/html/rfc8265#section-3.3
+IRC::Symbol IRC::intern(std::string_view name) {
+    if (name.empty())
+        return SymbolTable::none;
+    // The byte mappings are applied by the symbol table itself
+    if (mCaseMapping.utf8())
+        return mSymbols.intern(toLower(name));
+    return mSymbols.intern(name);
+}
 
-        // However, I think the most important parts are covered, for now.
+IRC::Symbol IRC::findSymbol(std::string_view name) {
+    if (mCaseMapping.utf8())
+        return mSymbols.find(toLower(name));
+    return mSymbols.find(name);
+}
 
-        // Convert string to icu's datatype
-        icu::UnicodeString u;
-        u.fromUTF8(s);
+bool IRC::setSymbol(Symbol &field, std::string_view name) {
+    // Refreshes from NAMES and WHO mostly repeat what we know
+    if (name.empty() || (field != SymbolTable::none && mSymbols.name(field) == name))
+        return false;
+    // Intern first, the symbol may be the one we are replacing
+    auto symbol = intern(name);
+    mSymbols.release(field);
+    field = symbol;
+    return true;
+}
 
-        //    1.  Width Mapping Rule: Map fullwidth and halfwidth code points to
-        //        their decomposition mappings (see Unicode Standard Annex #11
-        //        [UAX11]).
+bool IRC::setAccount(IRCUser &user, std::string_view account) {
+    bool known = std::exchange(user.accountKnown, true);
+    if (account != "*")
+        return setSymbol(user.account, account) || !known;
+    if (user.account == SymbolTable::none)
+        return !known;
+    mSymbols.release(user.account);
+    user.account = SymbolTable::none;
+    return true;
+}
 
-        // I have trouble finding the calls into ICU for the first step.
-        // Case mapping and normalisation, that looks ok
+void IRC::updateUser(IRCMessage &message) {
+    if (message.source.nick.empty() || message.source.host.empty())
+        return;
+    auto it = ircUsers.find(findSymbol(message.source.nick));
+    if (it == ircUsers.end())
+        return;
+    auto &user = it->second;
+    bool changed = setSymbol(user.user, message.source.user);
+    changed |= setSymbol(user.host, message.source.host);
+    if (serverInfo.capabilities.acknowledged.contains("account-tag")) {
+        // The tag is left out for users that are not logged in
+        if (message.tags.contains(IRCTags::HotTag::account))
+            changed |= setAccount(user, message.tags.get(IRCTags::HotTag::account));
+        else
+            changed |= setAccount(user, "*");
+    }
+    if (changed)
+        touchUser(user);
+}
 
-        //    2.  Additional Mapping Rule: There is no additional mapping rule.
+// Assigns a field of a user, telling whether it changed
+static bool assign(std::string &field, std::string_view value) {
+    if (field == value)
+        return false;
+    field = value;
+    return true;
+}
 
-        // Trivial ;)
+std::pair<const IRC::Symbol, IRC::IRCUser> &IRC::user(std::string_view nick) {
+    auto symbol = findSymbol(nick);
+    if (symbol != SymbolTable::none) {
+        auto it = ircUsers.find(symbol);
+        if (it != ircUsers.end())
+            return *it;
+    }
+    return *ircUsers.try_emplace(intern(nick)).first;
+}
 
-        //    3.  Case Mapping Rule: Map uppercase and titlecase code points to
-        //        their lowercase equivalents, preferably using the Unicode
-        //        toLowerCase() operation as defined in the Unicode Standard
-        //        [Unicode]; see further discussion in Section 3.2.
+IRC::IRCMember &IRC::addMember(std::string_view name, std::pair<const Symbol, IRCUser> &user) {
+    auto &[symbol, channel] = channelEntry(name);
+    auto [it, added] = channel.members.try_emplace(user.first);
+    if (added)
+        user.second.channels.push_back(symbol);
+    // The caller may change the membership as well
+    touch(symbol, channel);
+    return it->second;
+}
 
-        u.toLower();
+void IRC::removeMember(Symbol channel, Symbol nick) {
+    auto it = ircChannels.find(channel);
+    if (it != ircChannels.end() && it->second.members.erase(nick)) {
+        touch(channel, it->second);
+        leaveChannel(nick, channel);
+    }
+}
 
-        //    4.  Normalization Rule: Apply Unicode Normalization Form C (NFC) to
-        //        all strings.
+void IRC::leaveChannel(Symbol nick, Symbol channel) {
+    auto user = ircUsers.find(nick);
+    if (user == ircUsers.end())
+        return;
+    auto &channels = user->second.channels;
+    auto found = std::find(channels.begin(), channels.end(), channel);
+    if (found != channels.end()) {
+        *found = channels.back();
+        channels.pop_back();
+    }
+    if (channels.empty())
+        removeUser(nick);
+}
 
-        UErrorCode errorCode;
-        auto normalizer = icu::Normalizer2::getNFCInstance(errorCode);
-        // TODO error checking
-        u = normalizer->normalize(u, errorCode);
-        // TODO error checking
+void IRC::removeUser(Symbol nick) {
+    auto it = ircUsers.find(nick);
+    if (it == ircUsers.end())
+        return;
+    auto &user = it->second;
+    for (auto channel : user.channels) {
+        auto found = ircChannels.find(channel);
+        if (found != ircChannels.end()) {
+            found->second.members.erase(nick);
+            touch(channel, found->second);
+        }
+    }
+    for (auto symbol : {user.user, user.host, user.server, user.account})
+        mSymbols.release(symbol);
+    ircUsers.erase(it);
+    mSymbols.release(nick);
+}
 
-        //    5.  Directionality Rule: Apply the "Bidi Rule" defined in [RFC5893]
-        //        to strings that contain right-to-left code points (i.e., each of
-        //        the six conditions of the Bidi Rule must be satisfied); for
-        //        strings that do not contain right-to-left code points, there is
-        //        no special processing for directionality.
+void IRC::renameUser(std::string_view nick, std::string_view newNick) {
+    auto symbol = findSymbol(nick);
+    auto it = ircUsers.find(symbol);
+    if (symbol == SymbolTable::none || it == ircUsers.end() || newNick.empty())
+        return;
+    if (isEqual(nick, newNick)) {
+        // Only the case changes, the symbol stays
+        if (!mCaseMapping.utf8() && mSymbols.rename(symbol, newNick))
+            touchUser(it->second);
+        return;
+    }
 
-        // There is some bidi functionality in the ICU library, but I do not
-        // understand how any of that maps to any of the rules.
+    auto newSymbol = intern(newNick);
+    // A record left for the new nick is stale, the server says it is free
+    if (newSymbol != SymbolTable::none && ircUsers.contains(newSymbol))
+        removeUser(newSymbol);
+    auto node = ircUsers.extract(it);
+    node.key() = newSymbol;
+    auto &user = ircUsers.insert(std::move(node)).position->second;
+    touchUser(user);
+    for (auto channel : user.channels) {
+        auto found = ircChannels.find(channel);
+        if (found == ircChannels.end())
+            continue;
+        auto member = found->second.members.extract(symbol);
+        if (member) {
+            member.key() = newSymbol;
+            found->second.members.insert(std::move(member));
+        }
+    }
+    // Staged from NAMES, the reference moves along
+    for (auto channel : mStagingChannels) {
+        auto found = ircChannels.find(channel);
+        if (found == ircChannels.end())
+            continue;
+        auto staged = found->second.staging.extract(symbol);
+        if (staged) {
+            staged.key() = newSymbol;
+            if (found->second.staging.insert(std::move(staged)).inserted)
+                mSymbols.acquire(newSymbol);
+            mSymbols.release(symbol);
+        }
+    }
+    mSymbols.release(symbol);
+}
 
-        // Processing done: Convert it back to a std::string
-        u.toUTF8String(s);
+void IRC::removeChannel(Symbol channel) {
+    auto it = ircChannels.find(channel);
+    if (it == ircChannels.end())
+        return;
+    if (it->second.staging.size())
+        discardNames(channel, it->second);
+    // Its symbol may be reused before a WHO in flight ends
+    forgetWho(channel);
+    // The channel is no longer among their channels, so removeUser leaves
+    // the members alone while we iterate
+    for (auto &member : it->second.members)
+        leaveChannel(member.first, channel);
+    // Taken out of the snapshots at the next publish
+    std::string key(mSymbols.name(channel));
+    mCaseMapping.fold(key);
+    mRemovedChannels.push_back(std::move(key));
+    ircChannels.erase(it);
+    mSymbols.release(channel);
+}
+
+std::pair<const IRC::Symbol, IRC::IRCChannel> &IRC::channelEntry(std::string_view name) {
+    auto symbol = findSymbol(name);
+    if (symbol != SymbolTable::none) {
+        auto it = ircChannels.find(symbol);
+        if (it != ircChannels.end())
+            return *it;
     }
-#else
-    if (utf8Mapping) {
-        LOG_INFO("UTF8 Mapping has been disabled");
+    return *ircChannels.try_emplace(intern(name)).first;
+}
+
+IRC::IRCChannel &IRC::channel(std::string_view name) { return channelEntry(name).second; }
+
+bool IRC::isJoined(std::string_view name) {
+    auto it = ircChannels.find(findSymbol(name));
+    return it != ircChannels.end() && it->second.joined;
+}
+
+void IRC::touch(Symbol symbol, IRCChannel &channel) {
+    if (!channel.changed) {
+        channel.changed = true;
+        mChangedChannels.push_back(symbol);
     }
-#endif
-    return s;
 }
 
-bool IRC::isEqual(const std::string first, const std::string seccond) {
+void IRC::touchUser(IRCUser &user) {
+    user.snapshot.reset();
+    for (auto channel : user.channels) {
+        auto it = ircChannels.find(channel);
+        if (it != ircChannels.end())
+            touch(channel, it->second);
+    }
+}
 
-    // If the length differ, then they are not equal, we don't have to
-    // look further.
-    if (first.length() != seccond.length())
-        return false;
-    return toLower(first) == toLower(seccond);
+std::shared_ptr<const ChannelSnapshots> IRC::channels(void) { return mSnapshots.load(); }
+
+std::shared_ptr<const ChannelSnapshot> IRC::snapshot(Symbol symbol, IRCChannel &channel) {
+    auto snapshot = std::make_shared<ChannelSnapshot>();
+    snapshot->name = channel.name.length() ? channel.name : std::string(mSymbols.name(symbol));
+    snapshot->topic = channel.topic;
+    for (unsigned mode = 0; mode < channel.modes.size(); mode++) {
+        if (channel.modes[mode])
+            snapshot->modes += (char)mode;
+    }
+    snapshot->settings = channel.settings;
+    snapshot->members.reserve(channel.members.size());
+    for (auto &[nick, member] : channel.members) {
+        auto it = ircUsers.find(nick);
+        if (it == ircUsers.end())
+            continue;
+        // Shared by all channels of the user, until the user changes
+        auto &user = it->second;
+        if (!user.snapshot) {
+            user.snapshot = std::make_shared<const UserSnapshot>(
+                UserSnapshot{std::string(mSymbols.name(nick)), std::string(mSymbols.name(user.user)),
+                             std::string(mSymbols.name(user.host)), std::string(mSymbols.name(user.account)), user.realname});
+        }
+        std::string prefixes;
+        for (unsigned rank = 0; rank < mPrefixes.length(); rank++) {
+            if (member.modes & (1u << rank))
+                prefixes += mPrefixes[rank];
+        }
+        snapshot->members.push_back({user.snapshot, std::move(prefixes)});
+    }
+    return snapshot;
+}
+
+void IRC::publish(void) {
+    if (mChangedChannels.empty() && mRemovedChannels.empty() && !mRepublish)
+        return;
+
+    auto current = mSnapshots.load();
+    auto next = std::make_shared<ChannelSnapshots>();
+    if (current && !mRepublish)
+        next->shards = current->shards;
+    for (unsigned c = 0; c < next->fold.size(); c++)
+        next->fold[c] = mCaseMapping.fold(c);
+#ifdef ENABLE_ICU
+    // The names are interned folded with it
+    if (mCaseMapping.utf8())
+        next->utf8Fold = utf8Fold;
+#endif
+
+    // Shards are copied the first time they change, the others are shared
+    // with the current snapshots
+    std::array<std::shared_ptr<ChannelSnapshots::Shard>, ChannelSnapshots::shardCount> copies;
+    auto shard = [&](const std::string &key) -> ChannelSnapshots::Shard & {
+        auto index = ChannelSnapshots::shardOf(key);
+        if (!copies[index]) {
+            copies[index] = next->shards[index] ? std::make_shared<ChannelSnapshots::Shard>(*next->shards[index])
+                                                : std::make_shared<ChannelSnapshots::Shard>();
+            next->shards[index] = copies[index];
+        }
+        return *copies[index];
+    };
+    auto update = [&](Symbol symbol, IRCChannel &channel) {
+        channel.changed = false;
+        auto key = next->key(mSymbols.name(symbol));
+        if (channel.joined)
+            shard(key)[key] = snapshot(symbol, channel);
+        else if (next->shards[ChannelSnapshots::shardOf(key)])
+            shard(key).erase(key);
+    };
+
+    for (auto &key : mRemovedChannels)
+        shard(key).erase(key);
+    if (mRepublish) {
+        for (auto &channel : ircChannels)
+            update(channel.first, channel.second);
+    } else {
+        for (auto symbol : mChangedChannels) {
+            auto it = ircChannels.find(symbol);
+            if (it != ircChannels.end() && it->second.changed)
+                update(symbol, it->second);
+        }
+    }
+    mChangedChannels.clear();
+    mRemovedChannels.clear();
+    mRepublish = false;
+    mSnapshots.store(std::move(next));
 }
 void IRC::onCanRegister(void) {
 
@@ -455,11 +855,23 @@ void IRC::applyServerQuirks(void) {
 }
 
 void IRC::applyFeatures() {
-    auto channelModes = splitString(serverInfo.features["CHANMODES"], ",");
-    serverInfo.channelTypeAModes = channelModes[0];
-    serverInfo.channelTypeBModes = channelModes[1];
-    serverInfo.channelTypeCModes = channelModes[2];
-    serverInfo.channelTypeDModes = channelModes[3];
+    std::string *channelModeTypes[] = {&serverInfo.channelTypeAModes, &serverInfo.channelTypeBModes,
+                                       &serverInfo.channelTypeCModes, &serverInfo.channelTypeDModes};
+    StringTokenizer channelModes(serverInfo.features["CHANMODES"], ",");
+    for (auto channelModeType : channelModeTypes) {
+        std::string_view modes;
+        if (!channelModes.next(modes))
+            modes = {};
+        *channelModeType = modes;
+    }
+
+    // Compile the modes into a table, PREFIX adds the membership modes
+    const ModeType modeTypes[] = {ModeType::list, ModeType::setting, ModeType::parameter, ModeType::flag};
+    mModeClasses.fill({});
+    for (unsigned i = 0; i < 4; i++) {
+        for (char mode : *channelModeTypes[i])
+            mModeClasses[(uint8_t)mode].type = modeTypes[i];
+    }
 
     auto prefix = serverInfo.features["PREFIX"];
 
@@ -479,6 +891,15 @@ void IRC::applyFeatures() {
         for (unsigned i = 0; i < len; i++) {
             serverInfo.channelMembershipPrefixes[modes[i]] = prefixes[i];
         }
+        // At most 32 ranks fit the membership bits
+        mPrefixRanks.fill(0);
+        if (mPrefixes != prefixes.substr(0, 32))
+            mRepublish = true;
+        mPrefixes = prefixes.substr(0, 32);
+        for (unsigned i = 0; i < len && i < 32; i++) {
+            mModeClasses[(uint8_t)modes[i]] = {ModeType::membership, (uint8_t)i};
+            mPrefixRanks[(uint8_t)prefixes[i]] = i + 1;
+        }
     }
 }
 
@@ -505,7 +926,10 @@ void IRC::onReady(void) {
 }
 
 void IRC::onConnected() {
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
     serverInfo.connected = true;
+    mLineBuffer.clear();
+    mBatches.clear();
 
     // Set defaults
     serverInfo.hasCapabilities = false;
@@ -518,6 +942,12 @@ void IRC::onConnected() {
     serverInfo.features["CHANTYPES"] = "#&";
     serverInfo.features["MODES"] = "3";
     serverInfo.features["PREFIX"] = "(ov)@+";
+    configureCaseMapping();
+    publishTextBudget();
+
+    // If a server supports neither, we have a timeout. It is armed before
+    // probing, as a local server may answer before we get to the next line.
+    connectTimer.afterSeconds([this]() { onCanRegister(); }, std::chrono::seconds(3));
 
     // Probe for capabilities
     // Note: when the server does not support capabilities it may response
@@ -538,12 +968,36 @@ void IRC::onConnected() {
     // against. Note: OfficeIRC, a commercial product, https://www.officeirc.com/
     // claims "New IRCv3 features, improved IRCX support and server linking
     // support." So it could be possible an implementation supports both.
-
-    // If a server supports neither, we have a timeout.
-    connectTimer.afterSeconds([this]() { onCanRegister(); }, std::chrono::seconds(3));
 }
 
-void IRC::onDisconnected() { serverInfo.connected = false; }
+void IRC::onDisconnected() {
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+    serverInfo.connected = false;
+    mBatches.clear();
+    // NAMES replies that will not end now
+    for (auto channel : std::vector<Symbol>(mStagingChannels)) {
+        auto it = ircChannels.find(channel);
+        if (it != ircChannels.end())
+            discardNames(channel, it->second);
+    }
+    mStagingChannels.clear();
+    resetWho();
+    uint64_t dropped = 0;
+    for (IRCCommand::Code code = 0; code < IRCCommand::count; code++) {
+        if (!mDropped[code])
+            continue;
+        dropped += mDropped[code];
+        if (code < IRCCommand::numericCount) {
+            LOG_DEBUG("Dropped %d messages with numeric %03d", (int)mDropped[code], code);
+        } else {
+            [[maybe_unused]] auto verb = IRCCommand::verb(code);
+            LOG_DEBUG("Dropped %d messages with command %.*s", (int)mDropped[code], (int)verb.length(), verb.data());
+        }
+    }
+    LOG_INFO("Dropped %d messages without interest", (int)dropped);
+    LOG_INFO("Message arena: %d of %d bytes used at most, %d heap fallbacks", (int)mArena.highWaterMark(), (int)mArena.capacity(),
+             (int)mArena.fallbackAllocations());
+}
 
 void IRC::onUnknownCommand(IRCMessage &message) {
     //    if (message.command == Numeric::ERR_UNKNOWNCOMMAND) {
@@ -559,7 +1013,7 @@ void IRC::onWelcome(IRCMessage &message) {
     serverInfo.registrationComplete = true;
     // "<client> :Welcome to the <networkname> IRC Network,
     // <nick>[!<user>@<host>]"
-    if (message.parameters.size() > 0) {
+    if (message.parameters.size() > 1) {
 
         std::string preNetString = "Welcome to the ";
         std::string postNetString = " IRC Network";
@@ -571,7 +1025,16 @@ void IRC::onWelcome(IRCMessage &message) {
             LOG_INFO("Network : %s", serverInfo.network.c_str());
             std::string nickUserHost = message.parameters[1].substr(postNetString.length() + postNetPos + 1);
             LOG_INFO("NickUserHost : %s", nickUserHost.c_str());
+
+            IRCSourceView source{};
+            source.raw = nickUserHost;
+            splitUserNickHost(source);
+            if (source.host.length() && isEqual(source.nick, message.parameters[0]))
+                setOwnSource(source.nick, source.user, source.host);
         }
+        // The nick the server knows us by, it may have been truncated
+        if (message.parameters[0] != mNick)
+            setOwnSource(message.parameters[0], mOwnUser, mOwnHost);
     }
 }
 
@@ -650,22 +1113,16 @@ void IRC::onISupport(IRCMessage &message) {
              * servers to change their features without disconnecting clients.
              * Tokens of this form MUST NOT contain a value field.
              */
-            std::vector<std::string> isupprt;
-            isupprt.insert(isupprt.end(), message.parameters.begin() + 1, message.parameters.end() - 1);
-
-            // Merge doesn't replace the new values
-            // serverInfo.features.merge(parseKeyValue(isupprt));
-
-            for (auto &feature : parseKeyValue(isupprt)) {
-                serverInfo.features[feature.first] = feature.second;
-            }
-
-            auto negations = parseNegation(isupprt);
-            for (auto &negation : negations) {
-                serverInfo.features.erase(negation);
+            for (size_t i = 1; i < message.parameters.size() - 1; i++) {
+                applyKeyValue(serverInfo.features, message.parameters[i]);
                 // TODO: any processing for negated features.
                 // TODO: in what case such negation would occur?
             }
+            configureCaseMapping();
+            // LINELEN, USERLEN or HOSTLEN may have changed
+            publishTextBudget();
+            // As may CHANMODES or PREFIX
+            applyFeatures();
 
             return;
         }
@@ -695,12 +1152,8 @@ void IRC::onCAP(IRCMessage &message) {
             if (subCommand == "LS") {
                 bool moreCapabilitiesComing = message.parameters[2] == "*";
                 if (message.parameters.size() > (2u + moreCapabilitiesComing)) {
-                    auto capabilities = splitString(message.parameters[2 + moreCapabilitiesComing]);
-                    serverInfo.capabilities.supported.merge(parseKeyValue(capabilities));
-
-                    auto negations = parseNegation(capabilities);
-                    for (auto &negation : negations) {
-                        serverInfo.capabilities.supported.erase(negation);
+                    for (auto capability : StringTokenizer(message.parameters[2 + moreCapabilitiesComing])) {
+                        applyKeyValue(serverInfo.capabilities.supported, capability);
                         // TODO: any processing for negated capabilities?
                     }
 
@@ -712,8 +1165,11 @@ void IRC::onCAP(IRCMessage &message) {
                         requestCapabilityIfPresent("label");
                         requestCapabilityIfPresent("draft/labeled-response");
                         requestCapabilityIfPresent("account-notify");
+                        requestCapabilityIfPresent("account-tag");
                         requestCapabilityIfPresent("extended-join");
                         requestCapabilityIfPresent("away-notify");
+                        requestCapabilityIfPresent("multi-prefix");
+                        requestCapabilityIfPresent("userhost-in-names");
 
                         send("CAP END");
                         connectTimer.abortTimer();
@@ -724,35 +1180,37 @@ void IRC::onCAP(IRCMessage &message) {
 
             if (subCommand == "ACK") {
                 // serverInfo.capabilities.acknowledged.merge
-                auto capabilities = splitString(message.parameters[2]);
-                for (auto &capability : capabilities) {
-                    if (capability.length()) {
-                        if (capability[0] == '-') {
-                            capability = capability.substr(1);
+                for (auto token : StringTokenizer(message.parameters[2])) {
+                    if (token.length()) {
+                        if (token[0] == '-') {
+                            std::string capability(token.substr(1));
                             serverInfo.capabilities.acknowledged.erase(capability);
 
                             LOG_INFO("Removing %s from acknowlegded capabilities", capability.c_str());
                         } else {
+                            std::string capability(token);
                             serverInfo.capabilities.acknowledged.insert(capability);
                             LOG_INFO("Adding %s to acknowlegded capabilities", capability.c_str());
                         }
                     }
                 }
+                publishTextBudget();
             }
 
             if (subCommand == "NEW") {
-                auto capabilities = splitString(message.parameters[2]);
-                serverInfo.capabilities.supported.merge(parseKeyValue(capabilities));
+                for (auto capability : StringTokenizer(message.parameters[2]))
+                    applyKeyValue(serverInfo.capabilities.supported, capability);
                 LOG_INFO("Adding %s to supported capabilities", message.parameters[2].c_str());
             }
 
             if (subCommand == "DEL") {
-                auto capabilities = splitString(message.parameters[2]);
-                for (auto &capability : capabilities) {
+                for (auto token : StringTokenizer(message.parameters[2])) {
+                    std::string capability(token);
                     serverInfo.capabilities.supported.erase(capability);
                     LOG_INFO("Removing %s from supported capabilities", capability.c_str());
                     serverInfo.capabilities.acknowledged.erase(capability);
                 }
+                publishTextBudget();
             }
 
             if (subCommand == "LIST") {
@@ -774,16 +1232,18 @@ void IRC::onIRCX(IRCMessage &message) {
         } catch (...) {
             serverInfo.extensions.version = -1;
         }
-        serverInfo.extensions.packages = splitString(message.parameters[3]);
+        serverInfo.extensions.packages.clear();
+        for (auto package : StringTokenizer(message.parameters[3]))
+            serverInfo.extensions.packages.emplace_back(package);
         try {
             serverInfo.maxLen = std::stoi(message.parameters[4]); // TODO
         } catch (...) {
             serverInfo.maxLen = 512;
         }
-        if (message.parameters[5] == "*") {
-            serverInfo.extensions.options.clear();
-        } else {
-            serverInfo.extensions.options = splitString(message.parameters[5]);
+        serverInfo.extensions.options.clear();
+        if (message.parameters[5] != "*") {
+            for (auto option : StringTokenizer(message.parameters[5]))
+                serverInfo.extensions.options.emplace_back(option);
         }
         // TODO: check if we already have tried enabling,
         // preventing an endless loop if the server supports IRCX but
@@ -824,6 +1284,8 @@ void IRC::onPONG(IRCMessage &message) {
                     std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
                 lag = now - sent;
                 LOG_DEBUG("Lag is %d ms", (int)lag.count());
+                LOG_DEBUG("Message arena: %d bytes used at most, %d heap fallbacks", (int)mArena.highWaterMark(),
+                          (int)mArena.fallbackAllocations());
                 serverInfo.lag = lag;
             } catch (...) {
                 LOG_DEBUG("Unable to determine lag (parameter not integer)");
@@ -840,29 +1302,28 @@ void IRC::onPONG(IRCMessage &message) {
 }
 
 void IRC::onCTCPQuery(IRCMessage &message, CTCPMessage &ctcp) {
+    std::string sender(message.source.nick);
     if (ctcp.command == "ACTION") {
 
         auto recipient = message.parameters[0];
         auto action = ctcp.parameters;
         std::map<std::string, std::string> m = messageToClient(message);
         m["type"] = "action";
-        m["text/plain"] = stripFormatting(action);
-        m["text/irc"] = action;
-        if (mClient)
-            mClient->onMessage(m);
+        FormattedText text(std::move(action));
+        textToClient(m, text);
 
     } else if (ctcp.command == "CLIENTINFO") {
     } else if (ctcp.command == "DCC") {
     } else if (ctcp.command == "FINGER") {
     } else if (ctcp.command == "PING") {
-        sendCTCPResponse(message.source.nick, ctcp.command, ctcp.parameters);
+        sendCTCPResponse(sender, ctcp.command, ctcp.parameters);
     } else if (ctcp.command == "SOURCE") {
-        sendCTCPResponse(message.source.nick, "SOURCE", "https://github.com/BlaatSchaapCode/blaatbot2025/");
+        sendCTCPResponse(sender, "SOURCE", "https://github.com/BlaatSchaapCode/blaatbot2025/");
     } else if (ctcp.command == "TIME") {
-        sendCTCPResponse(message.source.nick, "TIME", getTimeString());
+        sendCTCPResponse(sender, "TIME", getTimeString());
     } else if (ctcp.command == "VERSION") {
         utils::Version version;
-        sendCTCPResponse(message.source.nick, "VERSION", "BlaatBot2025 " + version.m_git_commit);
+        sendCTCPResponse(sender, "VERSION", "BlaatBot2025 " + version.m_git_commit);
     } else if (ctcp.command == "USERINFO") {
     }
 }
@@ -874,11 +1335,14 @@ void IRC::onCTCPResponse(IRCMessage &message, CTCPMessage &ctcp) {
         // Note... we might need to analyse some services
         // ergo responds "NickServ (ergo-v2.15.0)"
         if (message.parameters.size() > 0) {
-            if (isEqual(splitString(ctcp.parameters)[0], "NickServ")) {
-                if (message.parameters.size() > 1)
-                    serverInfo.services = splitString(ctcp.parameters)[1];
+            StringTokenizer words(ctcp.parameters);
+            std::string_view word;
+            words.next(word);
+            if (isEqual(word, "NickServ")) {
+                if (message.parameters.size() > 1 && words.next(word))
+                    serverInfo.services = word;
             } else {
-                serverInfo.services = splitString(ctcp.parameters)[0];
+                serverInfo.services = word;
             }
 
             if (serverInfo.services.length()) {
@@ -892,108 +1356,16 @@ void IRC::onCTCPResponse(IRCMessage &message, CTCPMessage &ctcp) {
     }
 }
 
-std::string IRC::stripFormatting(const std::string &formattedString) {
-    // TODO strip all formatting
-    // https://modern.ircdocs.horse/formatting
-
+std::string IRC::stripFormatting(std::string_view formattedString) {
     std::string strippedString;
-
-    enum code {
-        bold = 0x02,
-        color = 0x03,
-        hexcolor = 0x04,
-        reset = 0x0f,
-        reversedcolor = 0x16,
-
-        texticon = 0x1c,
-        italics = 0x1d,
-        underline = 0x1f,
-        strikethrough = 0x1e,
-        monospace = 0x11,
-    };
-
-    for (unsigned i = 0; i < formattedString.length(); i++) {
-
-        switch ((unsigned char)formattedString[i]) {
-        default:
-            // Characters in the ASCII control range are used for
-            // formatting and are stripped from the string
-            // Special handling is only needed when they take parameters
-            break;
-        case 0x20 ... 0xFF:
-            // Characters above the ASCII control range are considered text,
-            // unless we are in a special case handling of parameters, below.
-            strippedString += formattedString[i];
-            break;
-        case color:
-            // needs special handling to consume its parameters
-            /*
-      Forms of Color Codes
-
-      In the following list, <CODE> represents the color formatting character (0x03),
-      <COLOR> represents one or two ASCII digits (either 0-9 or 00-99).
-
-      The use of this code can take on the following forms:
-
-      <CODE> - Reset foreground and background colors.
-      <CODE>, - Reset foreground and background colors and display the , character as
-      text. <CODE><COLOR> - Set the foreground color. <CODE><COLOR>, - Set the
-      foreground color and display the , character as text. <CODE><COLOR>,<COLOR> -
-      Set the foreground and background color.
-      */
-            // Eat the "CODE"
-            if (i + 1 < formattedString.length())
-                i++;
-
-            // If digit, eat digit
-            if (i + 1 < formattedString.length() && formattedString[i] >= '0' && formattedString[i] <= '9')
-                i++;
-            // If digit, eat digit
-            if (i + 1 < formattedString.length() && formattedString[i] >= '0' && formattedString[i] <= '9')
-                i++;
-            // If comma, eat comma
-            if (i + 1 < formattedString.length() && formattedString[i] == ',') {
-                i++;
-                // We are after a comma, we could eat two more digits.
-                if (i + 1 < formattedString.length() && formattedString[i] >= '0' && formattedString[i] <= '9')
-                    i++;
-                if (i + 1 < formattedString.length() && formattedString[i] >= '0' && formattedString[i] <= '9')
-                    i++;
-            }
-            // With above processing, we have eaten one byte too many, so give it back
-            i--;
-
-            break;
-        case hexcolor:
-            // needs special handling to consume its parameters
-            /*
-            Keep the Forms of Color Codes section above in mind, as this method of
-            formatting keeps these same rules – the exceptions being that <CODE>
-            represents the hex color character (0x04) and <COLOR> represents a
-            six-digit hex value as RRGGBB.
-            */
-            // Length is fixed, we eat the next 6 bytes without further checking.
-            if (i + 6 < formattedString.length())
-                i += 6;
-            break;
-        case texticon:
-            // needs special handling to consume its parameters
-            // KvIRC extension, read till space
-            if (formattedString.find(' ') != std::string::npos) {
-                i += formattedString.find(' ');
-            } else {
-                // if there is no space, eg. the texticon appears at the
-                // end of the string, we are done parsing, put i to the end
-                i = formattedString.length();
-            }
-            break;
-        }
-    }
-
+    auto stripped = IRCFormatting::strip(formattedString, strippedString);
+    if (stripped.data() != strippedString.data())
+        return std::string(stripped);
     return strippedString;
 }
 
 void IRC::onPRIVMSG(IRCMessage &message) {
+    updateUser(message);
     if (message.parameters.size() == 2) {
         std::string recipient = message.parameters[0];
         std::string privmsg = message.parameters[1];
@@ -1028,20 +1400,18 @@ void IRC::onPRIVMSG(IRCMessage &message) {
 
         std::map<std::string, std::string> m = messageToClient(message);
         m["type"] = "message";
-        m["text/plain"] = stripFormatting(privmsg);
-        m["text/irc"] = privmsg;
-
-        if (mClient)
-            mClient->onMessage(m);
+        FormattedText text(std::move(privmsg));
+        textToClient(m, text);
 
     } else {
         // Malformed message?
     }
 }
 
-void IRC::onTAGMSG(IRCMessage &message) {}
+void IRC::onTAGMSG(IRCMessage &message) { updateUser(message); }
 
 void IRC::onNOTICE(IRCMessage &message) {
+    updateUser(message);
     if (message.parameters.size() == 2) {
         std::string recipient = message.parameters[0];
         std::string notice = message.parameters[1];
@@ -1076,10 +1446,8 @@ void IRC::onNOTICE(IRCMessage &message) {
 
         std::map<std::string, std::string> m = messageToClient(message);
         m["type"] = "notice";
-        m["text/plain"] = stripFormatting(notice);
-        m["text/irc"] = notice;
-        if (mClient)
-            mClient->onMessage(m);
+        FormattedText text(std::move(notice));
+        textToClient(m, text);
 
     } else {
         // Malformed message?
@@ -1089,156 +1457,220 @@ void IRC::onERROR(IRCMessage &message) {}
 
 void IRC::onJOIN(IRCMessage &message) {
     if (message.parameters.size() > 0) {
-        auto channel = toLower(message.parameters[0]);
+        auto &channel = this->channel(message.parameters[0]);
         if (isEqual(mNick, message.source.nick)) {
             // We have joined a channel
-            ircChannels[channel].joined = true;
+            channel.joined = true;
+            // Our own JOIN shows how the server relays our messages
+            if (std::string_view(message.source.user) != mOwnUser || std::string_view(message.source.host) != mOwnHost)
+                setOwnSource(message.source.nick, message.source.user, message.source.host);
             // We index on the lowe case string, we store the string with case
             // preserved for displaying purposes
-            ircChannels[toLower(message.parameters[0])].name = message.parameters[0];
+            channel.name = message.parameters[0];
             // Obtain the channel modes
-            send("MODE " + channel);
-        } else {
-            // Someone else has joined a channel we are in
-            // --> Update channel member list
-            IRCUser joined;
-            joined.nick = message.source.nick;
-            joined.user = message.source.user;
-            joined.host = message.source.host;
-
-            if (message.parameters.size() > 2) {
-                // extended join
-                joined.account = message.parameters[1];
-                joined.realname = message.parameters[2];
+            send("MODE " + toLower(message.parameters[0]));
+        }
+        if (message.source.nick.empty())
+            return;
+
+        // --> Update channel member list
+        auto &joined = user(message.source.nick);
+        bool changed = setSymbol(joined.second.user, message.source.user);
+        changed |= setSymbol(joined.second.host, message.source.host);
+        if (message.parameters.size() > 2) {
+            // extended join
+            changed |= setAccount(joined.second, message.parameters[1]);
+            changed |= assign(joined.second.realname, message.parameters[2]);
+        }
+        if (changed)
+            touchUser(joined.second);
+        addMember(message.parameters[0], joined);
+    }
+}
+
+void IRC::onPART(IRCMessage &message) {
+    // "PART <channel>{,<channel>} [<reason>]"
+    if (message.parameters.size() > 0) {
+        bool self = isEqual(mNick, message.source.nick);
+        auto nick = findSymbol(message.source.nick);
+        for (auto name : StringTokenizer(message.parameters[0], ",")) {
+            auto channel = findSymbol(name);
+            if (self)
+                removeChannel(channel);
+            else
+                removeMember(channel, nick);
+        }
+    }
+}
+
+void IRC::onKICK(IRCMessage &message) {
+    // "KICK <channel> <user>{,<user>} [<comment>]"
+    if (message.parameters.size() > 1) {
+        auto channel = findSymbol(message.parameters[0]);
+        for (auto nick : StringTokenizer(message.parameters[1], ",")) {
+            if (isEqual(mNick, nick)) {
+                removeChannel(channel);
+                break;
             }
-            ircChannels[channel].nicks[toLower(message.source.nick)] = joined;
+            removeMember(channel, findSymbol(nick));
         }
     }
 }
 
+void IRC::onACCOUNT(IRCMessage &message) {
+    // https://ircv3.net/specs/extensions/account-notify
+    // ":nick!user@host ACCOUNT <accountname>", "*" when logged out
+    if (message.parameters.size() > 0) {
+        auto it = ircUsers.find(findSymbol(message.source.nick));
+        if (it != ircUsers.end() && setAccount(it->second, message.parameters[0]))
+            touchUser(it->second);
+    }
+}
+
+void IRC::onQUIT(IRCMessage &message) {
+    // ":nick!user@host QUIT :<reason>", our own QUIT is followed by the
+    // connection closing
+    if (!isEqual(mNick, message.source.nick))
+        removeUser(findSymbol(message.source.nick));
+}
+
 void IRC::onChannelModeIs(IRCMessage &message) {
     // The RPL_CHANNELMODEIS message looks like
     // "<client> <channel> <modestring> <mode arguments>..."
-    // We drop the <client> and let the onMODE handler process it
-
-    if (message.parameters.size() > 0) {
-        IRCMessage adjusted = message;
-        adjusted.parameters.erase(adjusted.parameters.begin());
-        onMODE(adjusted);
+    if (message.parameters.size() > 2) {
+        auto it = ircChannels.find(findSymbol(message.parameters[1]));
+        if (it != ircChannels.end()) {
+            applyModes(it->second, message.parameters, 2);
+            touch(it->first, it->second);
+        }
     }
 }
 
 void IRC::onMODE(IRCMessage &message) {
+    // "MODE <target> <modestring> [<mode arguments>...]"
+    // Channels we know of are the only ones we can receive modes for, user
+    // modes are not tracked.
     if (message.parameters.size() > 1) {
-        auto target = message.parameters[0];
-        if (isChannel(target)) {
-            /*
-                    Channel Membership:
-                    Server MUST NOT list modes in this parameter that are also
-               advertised in the PREFIX parameter. However, modes within the PREFIX
-               parameter may be treated as type B modes.
-
-
-                Type A: Modes that add or remove an address to or from a list. These
-               modes MUST always have a parameter when sent from the server to a
-               client. A client MAY issue this type of mode without an argument to
-               obtain the current contents of the list. The numerics used to retrieve
-               contents of Type A modes depends on the specific mode. Also see the
-               EXTBAN parameter.
-
-                Type B: Modes that change a setting on a channel. These modes MUST
-               always have a parameter.
-
-                Type C: Modes that change a setting on a channel. These modes MUST
-               have a parameter when being set, and MUST NOT have a parameter when
-               being unset.
-
-                Type D: Modes that change a setting on a channel. These modes MUST NOT
-               have a parameter.
-            */
-
-            int parameter = 0;
-            struct modechange_t {
-                char modeset;
-                char modechar;
-                int parameter;
-            };
-            std::vector<modechange_t> modeChanges;
-
-            auto modestring = message.parameters[1];
-
-            char modeset = 0;
-            unsigned pos = 0;
-            while (pos < modestring.length()) {
-                char modechar = modestring[pos];
-                pos++;
-                if (modechar == '+' || modechar == '-') {
-                    modeset = modechar;
-                    continue;
-                }
+        auto it = ircChannels.find(findSymbol(message.parameters[0]));
+        if (it != ircChannels.end()) {
+            applyModes(it->second, message.parameters, 1);
+            touch(it->first, it->second);
+        }
+    }
+}
 
-                if (modeset == '+' || modeset == '-') {
+uint32_t IRC::prefixModes(std::string_view prefixes) {
+    uint32_t modes = 0;
+    for (char prefix : prefixes) {
+        if (auto rank = mPrefixRanks[(uint8_t)prefix])
+            modes |= 1u << (rank - 1);
+    }
+    return modes;
+}
 
-                    modechange_t modechange = {.modeset = modeset, .modechar = modechar, .parameter = -1};
+void IRC::applyModes(IRCChannel &channel, const std::pmr::vector<std::string> &parameters, size_t first) {
+    /*
+        Channel Membership: Server MUST NOT list modes in this parameter that
+        are also advertised in the PREFIX parameter. However, modes within
+        the PREFIX parameter may be treated as type B modes.
 
-                    if (serverInfo.channelMembershipPrefixes.contains(modechar)) {
-                        // Channel Membership
-                        // Always takes parameter
-                        modechange.parameter = parameter++;
-                    }
-                    if (serverInfo.channelTypeAModes.find(modechar) != std::string::npos) {
-                        // Mode Type A
-                        // Add address to list
-                        // Always takes parameter in message from server
-                        modechange.parameter = parameter++;
-                    }
-                    if (serverInfo.channelTypeBModes.find(modechar) != std::string::npos) {
-                        // Mode Type B
-                        // Change setting on channel
-                        // Always takes parameter
-                        modechange.parameter = parameter++;
-                    }
-                    if (serverInfo.channelTypeCModes.find(modechar) != std::string::npos) {
-                        // Mode Type C
-                        // Change setting on channel
-                        // Takes parameter when being set
-                        // Takes no parameter when being unset
-                        if (modeset == '+')
-                            modechange.parameter = parameter++;
-                    }
-                    if (serverInfo.channelTypeDModes.find(modechar) != std::string::npos) {
-                        // Mode Type D
-                        // Change setting on channel
-                        // No parameters
-                    }
+        Type A: Modes that add or remove an address to or from a list. These
+        modes MUST always have a parameter when sent from the server to a
+        client.
 
-                    modeChanges.push_back(modechange);
-                } else {
-                    // Incorrectly formatted modestring
+        Type B: Modes that change a setting on a channel. These modes MUST
+        always have a parameter.
+
+        Type C: Modes that change a setting on a channel. These modes MUST
+        have a parameter when being set, and MUST NOT have a parameter when
+        being unset.
+
+        Type D: Modes that change a setting on a channel. These modes MUST NOT
+        have a parameter.
+    */
+    std::string_view modestring = parameters[first];
+    size_t argument = first + 1;
+    char modeset = 0;
+    for (char mode : modestring) {
+        if (mode == '+' || mode == '-') {
+            modeset = mode;
+            continue;
+        }
+        if (!modeset) {
+            // Incorrectly formatted modestring
+            return;
+        }
+        bool set = modeset == '+';
+        auto modeClass = mModeClasses[(uint8_t)mode];
+
+        std::string_view parameter;
+        switch (modeClass.type) {
+        case ModeType::list:
+        case ModeType::setting:
+        case ModeType::membership:
+            if (argument >= parameters.size())
+                return;
+            parameter = parameters[argument++];
+            break;
+        case ModeType::parameter:
+            if (set) {
+                if (argument >= parameters.size())
                     return;
-                }
+                parameter = parameters[argument++];
             }
+            break;
+        default:
+            break;
+        }
 
-            // Now we have created a list of modes to be set and unset, with their
-            // respective parameter.
-
-            LOG_DEBUG("Setting modes on channel: %s", target.c_str());
-            for (auto &modeChange : modeChanges) {
-                std::string modeParameter;
-                if (modeChange.parameter != -1) {
-                    unsigned parameter = modeChange.parameter + 2;
-                    if (message.parameters.size() > parameter) {
-                        modeParameter = message.parameters[parameter];
-                    } else {
-                        modeParameter = "ERROR";
-                    }
-                }
-                LOG_DEBUG("%c%c %s", modeChange.modeset, modeChange.modechar, modeParameter.c_str());
-                // TODO: Now we should process that what we have gathered
+        switch (modeClass.type) {
+        case ModeType::membership: {
+            auto member = channel.members.find(findSymbol(parameter));
+            if (member != channel.members.end()) {
+                if (set)
+                    member->second.modes |= 1u << modeClass.rank;
+                else
+                    member->second.modes &= ~(1u << modeClass.rank);
             }
-
-        } else {
-            // Mode on user.
+            break;
+        }
+        case ModeType::list: {
+            auto list = std::find_if(channel.lists.begin(), channel.lists.end(),
+                                     [mode](const auto &list) { return list.first == mode; });
+            if (set) {
+                if (list == channel.lists.end())
+                    list = channel.lists.insert(list, {mode, {}});
+                list->second.emplace(parameter);
+            } else if (list != channel.lists.end()) {
+                auto entry = list->second.find(parameter);
+                if (entry != list->second.end())
+                    list->second.erase(entry);
+            }
+            break;
+        }
+        case ModeType::setting:
+        case ModeType::parameter: {
+            auto setting = std::find_if(channel.settings.begin(), channel.settings.end(),
+                                        [mode](const auto &setting) { return setting.first == mode; });
+            if (!set) {
+                if (setting != channel.settings.end())
+                    channel.settings.erase(setting);
+            } else if (setting != channel.settings.end()) {
+                setting->second = parameter;
+            } else {
+                channel.settings.emplace_back(mode, parameter);
+            }
+            break;
+        }
+        case ModeType::flag:
+            channel.modes.set((uint8_t)mode, set);
+            break;
+        case ModeType::unknown:
+            // Without CHANMODES we cannot tell whether it takes a parameter,
+            // the server did not advertise it so assume it does not
+            LOG_DEBUG("Unknown channel mode %c", mode);
+            channel.modes.set((uint8_t)mode, set);
+            break;
         }
     }
 }
@@ -1247,53 +1679,293 @@ void IRC::onTopic(IRCMessage &message) {
     // <client> <channel> :<topic>"
     // Do we have to care about the client in the message?
     if (message.parameters.size() >= 3) {
-        ircChannels[toLower(message.parameters[1])].topic = message.parameters[2];
-        ircChannels[toLower(message.parameters[1])].topicStripped = stripFormatting(message.parameters[2]);
+        // Also sent in reply to a TOPIC for a channel we are not in
+        auto symbol = findSymbol(message.parameters[1]);
+        auto it = ircChannels.find(symbol);
+        if (symbol == SymbolTable::none || it == ircChannels.end() || !it->second.joined)
+            return;
+        auto &channel = it->second;
+        channel.topic = message.parameters[2];
+        channel.topicStripped = stripFormatting(message.parameters[2]);
+        touch(symbol, channel);
     }
 }
 
 void IRC::onTopicWhoTime(IRCMessage &message) {
     if (message.parameters.size() >= 4) {
-        ircChannels[toLower(message.parameters[1])].topicNick = message.parameters[2];
-        ircChannels[toLower(message.parameters[1])].topicSetAt = atoi(message.parameters[3].c_str());
+        auto it = ircChannels.find(findSymbol(message.parameters[1]));
+        if (it == ircChannels.end() || !it->second.joined)
+            return;
+        auto &channel = it->second;
+        channel.topicNick = message.parameters[2];
+        channel.topicSetAt = atoi(message.parameters[3].c_str());
     }
 }
 
 void IRC::onNamReply(IRCMessage &message) {
-    // But I suppose, don't bother, send a WHO command instead
     // "<client> <symbol> <channel> :[prefix]<nick>{ [prefix]<nick>}"
-    //	if (message.parameters.size() >= 4) {
-    //		auto symbol = toLower(message.parameters[1]);
-    //
-    //		auto names = splitString(message.parameters[3]);
-    //		for (auto &name : names) {
-    //			// look up and process prefix
-    //			// PREFIX=(qaohv)~&@%+
-    //
-    //
-    //			if (serverInfo.features.count("PREFIX")) {
-    //			}
-    //		}
-    //		mIRCChannels[toLower(message.parameters[2])];
-    //	}
+    // With multi-prefix a nick carries all its prefixes, highest rank
+    // first, and with userhost-in-names it is given as nick!user@host.
+    if (message.parameters.size() < 4)
+        return;
+    auto symbol = findSymbol(message.parameters[2]);
+    auto it = ircChannels.find(symbol);
+    if (symbol == SymbolTable::none || it == ircChannels.end() || !it->second.joined)
+        return;
+    auto &channel = it->second;
+
+    // Large channels take many replies, size the set once for all of them
+    std::string_view names = message.parameters[3];
+    size_t count = std::count(names.begin(), names.end(), ' ') + 1;
+    if (channel.staging.empty()) {
+        channel.staging.reserve(std::max(channel.members.size(), count));
+        mStagingChannels.push_back(symbol);
+    } else {
+        channel.staging.reserve(channel.staging.size() + count);
+    }
+
+    for (auto name : StringTokenizer(names)) {
+        size_t prefixes = 0;
+        while (prefixes < name.length() && mPrefixRanks[(uint8_t)name[prefixes]])
+            prefixes++;
+        auto modes = prefixModes(name.substr(0, prefixes));
+        name.remove_prefix(prefixes);
+        std::string_view userName, host;
+        auto bang = name.find('!');
+        if (bang != std::string_view::npos) {
+            auto userHost = name.substr(bang + 1);
+            name = name.substr(0, bang);
+            auto at = userHost.find('@');
+            userName = userHost.substr(0, at);
+            if (at != std::string_view::npos)
+                host = userHost.substr(at + 1);
+        }
+        if (name.empty())
+            continue;
+
+        // The user record is shared, only the membership waits for 366
+        auto &entry = user(name);
+        if (setSymbol(entry.second.user, userName) | setSymbol(entry.second.host, host))
+            touchUser(entry.second);
+        auto [staged, added] = channel.staging.try_emplace(entry.first);
+        if (added)
+            mSymbols.acquire(entry.first);
+        staged->second.modes = modes;
+    }
+}
+
+void IRC::commitNames(Symbol symbol, IRCChannel &channel) {
+    for (auto &[nick, member] : channel.members) {
+        auto staged = channel.staging.find(nick);
+        if (staged != channel.staging.end()) {
+            // Keep what WHO told us
+            staged->second.flags = std::move(member.flags);
+            staged->second.oplevel = std::move(member.oplevel);
+        } else {
+            leaveChannel(nick, symbol);
+        }
+    }
+    for (auto it = channel.staging.begin(); it != channel.staging.end();) {
+        auto nick = it->first;
+        auto user = ircUsers.find(nick);
+        if (user == ircUsers.end()) {
+            // Gone while the replies came in
+            it = channel.staging.erase(it);
+        } else {
+            if (!channel.members.contains(nick))
+                user->second.channels.push_back(symbol);
+            it++;
+        }
+        // The user record holds on to the nick from here
+        mSymbols.release(nick);
+    }
+    channel.members.swap(channel.staging);
+    // Release the buckets of the old list
+    channel.staging = {};
+    std::erase(mStagingChannels, symbol);
+    touch(symbol, channel);
+}
+
+void IRC::discardNames(Symbol symbol, IRCChannel &channel) {
+    std::erase(mStagingChannels, symbol);
+    for (auto &staged : channel.staging) {
+        auto nick = staged.first;
+        auto user = ircUsers.find(nick);
+        // Created for this reply only, unless staged elsewhere too
+        if (user != ircUsers.end() && user->second.channels.empty() &&
+            std::none_of(mStagingChannels.begin(), mStagingChannels.end(), [&](Symbol other) {
+                auto it = ircChannels.find(other);
+                return it != ircChannels.end() && it->second.staging.contains(nick);
+            }))
+            removeUser(nick);
+        mSymbols.release(nick);
+    }
+    channel.staging = {};
 }
 
 void IRC::onEndOfNames(IRCMessage &message) {
+    // "<client> <channel> :End of /NAMES list"
     if (message.parameters.size() >= 3) {
+        auto symbol = findSymbol(message.parameters[1]);
+        auto it = ircChannels.find(symbol);
+        if (symbol == SymbolTable::none || it == ircChannels.end())
+            return;
+        if (it->second.staging.size())
+            commitNames(symbol, it->second);
+        if (it->second.joined)
+            queueWho(symbol, it->second);
+    }
+}
+
+void IRC::queueWho(Symbol symbol, IRCChannel &channel, bool priority) {
+    if (channel.who == WhoState::sent || channel.who == WhoState::synced)
+        return;
+    for (auto &name : mWhoPriority)
+        priority |= findSymbol(name) == symbol;
+    // A queued channel only gets queued again to move it to the front, the
+    // stale entry is skipped later
+    if (channel.who == WhoState::queued && !priority)
+        return;
+
+    if (!mSyncing) {
+        mSyncing = true;
+        mSyncStart = std::chrono::steady_clock::now();
+        mSyncRequests = mSyncSkipped = 0;
+    }
+    channel.who = WhoState::queued;
+    mWhoQueue.emplace_back(priority ? 0 : channel.members.size() + 1, mWhoOrder++, symbol);
+    std::push_heap(mWhoQueue.begin(), mWhoQueue.end(), std::greater<>());
+    pumpWho();
+}
+
+void IRC::pumpWho(void) {
+    auto now = std::chrono::steady_clock::now();
+    // The timer is due, or fired while we held the lock
+    if (mWhoWake <= now)
+        mWhoWake = {};
+
+    std::vector<std::string> posted;
+    {
+        std::lock_guard<std::mutex> lock(mWhoPostedMutex);
+        posted.swap(mWhoPosted);
+    }
+    for (auto &name : posted) {
+        auto symbol = findSymbol(name);
+        auto it = ircChannels.find(symbol);
+        if (symbol != SymbolTable::none && it != ircChannels.end() && it->second.joined)
+            queueWho(symbol, it->second, true);
+    }
+
+    // A request the server never finished should not hold up the queue
+    std::erase_if(mWhoInFlight, [&](const WhoRequest &request) {
+        if (now - request.sent < std::chrono::minutes(1))
+            return false;
+        auto name = mSymbols.name(request.channel);
+        LOG_WARNING("No end of WHO for %.*s", (int)name.length(), name.data());
+        auto it = ircChannels.find(request.channel);
+        if (it != ircChannels.end())
+            it->second.who = WhoState::none;
+        return true;
+    });
+
+    while (mWhoInFlight.size() < mWhoInFlightLimit && mWhoQueue.size() && now >= mWhoNext) {
+        std::pop_heap(mWhoQueue.begin(), mWhoQueue.end(), std::greater<>());
+        auto symbol = std::get<2>(mWhoQueue.back());
+        mWhoQueue.pop_back();
+        auto it = ircChannels.find(symbol);
+        if (it == ircChannels.end() || it->second.who != WhoState::queued)
+            continue;
+        auto &channel = it->second;
+        if (whoComplete(channel)) {
+            channel.who = WhoState::synced;
+            mSyncSkipped++;
+            continue;
+        }
+
         if (serverInfo.features.count("WHOX")) {
-            // unsigned token = rand() % 100;
-            std::random_device r;
-            std::default_random_engine e1(r());
-            std::uniform_int_distribution<unsigned> uniform_dist(1, 99);
-            unsigned token = uniform_dist(e1);
-            ircChannels[toLower(message.parameters[1])].token = token;
-            send("WHO " + toLower(message.parameters[1]) + " %t%c%u%i%h%s%n%f%d%l%a%o%r," + std::to_string(token));
+            // Tokens are at most 3 digits
+            mWhoToken = mWhoToken % 999 + 1;
+            channel.token = mWhoToken;
+            send("WHO " + toLower(channel.name) + " %t%c%u%i%h%s%n%f%d%l%a%o%r," + std::to_string(channel.token));
         } else {
-            send("WHO " + toLower(message.parameters[1]));
+            channel.token = 0;
+            send("WHO " + toLower(channel.name));
         }
+        channel.who = WhoState::sent;
+        mWhoInFlight.push_back({symbol, channel.token, now});
+        mWhoNext = now + mWhoInterval;
+        mSyncRequests++;
+    }
+    armWho(now);
+
+    if (mSyncing && mWhoQueue.empty() && mWhoInFlight.empty()) {
+        mSyncing = false;
+        serverInfo.syncTime = std::chrono::duration_cast<std::chrono::milliseconds>(now - mSyncStart);
+        LOG_INFO("Synced in %d ms, %u WHO requests, %u channels already complete", (int)serverInfo.syncTime.count(),
+                 mSyncRequests, mSyncSkipped);
+        std::map<std::string, std::string> m;
+        m["type"] = "synced";
+        m["irc/sync/ms"] = std::to_string(serverInfo.syncTime.count());
+        m["irc/sync/requests"] = std::to_string(mSyncRequests);
+        m["irc/sync/skipped"] = std::to_string(mSyncSkipped);
+        if (mClient)
+            mClient->onMessage(m);
     }
 }
 
+void IRC::armWho(std::chrono::steady_clock::time_point now) {
+    // Nothing else may pump the queue in time on a quiet connection
+    auto wake = std::chrono::steady_clock::time_point::max();
+    if (mWhoQueue.size() && mWhoInFlight.size() < mWhoInFlightLimit)
+        wake = mWhoNext;
+    for (auto &request : mWhoInFlight)
+        wake = std::min(wake, request.sent + std::chrono::minutes(1));
+    if (mClosing || wake == std::chrono::steady_clock::time_point::max() || wake == mWhoWake)
+        return;
+    mWhoWake = wake;
+    auto delay = std::chrono::ceil<std::chrono::milliseconds>(wake - now);
+    whoTimer.afterMilliseconds([this]() { onWhoTimer(); }, std::max(delay, std::chrono::milliseconds(1)));
+}
+
+void IRC::onWhoTimer(void) {
+    // Never waits for the lock: its holder may be arming the timer, which
+    // waits for us. It pumps the queue itself when done with its data.
+    std::unique_lock<std::recursive_mutex> lock(mMutex, std::try_to_lock);
+    if (lock.owns_lock() && !mClosing)
+        pumpWho();
+}
+
+void IRC::resetWho(void) {
+    mWhoQueue.clear();
+    mWhoInFlight.clear();
+    mWhoNext = {};
+    mSyncing = false;
+    for (auto &channel : ircChannels)
+        channel.second.who = WhoState::none;
+}
+
+void IRC::forgetWho(Symbol channel) {
+    std::erase_if(mWhoInFlight, [channel](const WhoRequest &request) { return request.channel == channel; });
+    if (std::erase_if(mWhoQueue, [channel](const QueuedWho &queued) { return std::get<2>(queued) == channel; }))
+        std::make_heap(mWhoQueue.begin(), mWhoQueue.end(), std::greater<>());
+}
+
+bool IRC::whoComplete(const IRCChannel &channel) {
+    // Without these, what we know may be incomplete or outdated
+    auto &acknowledged = serverInfo.capabilities.acknowledged;
+    if (!acknowledged.contains("extended-join") || !acknowledged.contains("account-notify"))
+        return false;
+    for (auto &member : channel.members) {
+        auto it = ircUsers.find(member.first);
+        if (it == ircUsers.end())
+            return false;
+        auto &user = it->second;
+        if (user.user == SymbolTable::none || user.host == SymbolTable::none || !user.accountKnown)
+            return false;
+    }
+    return true;
+}
+
 void IRC::onWhoSpcReply(IRCMessage &message) {
     // WHOX Response
     // https://ircv3.net/specs/extensions/whox
@@ -1301,56 +1973,87 @@ void IRC::onWhoSpcReply(IRCMessage &message) {
     // [hopcount] [idle] [account] [oplevel] [:realname]
 
     if (message.parameters.size() > 13) {
-        IRCUser user = {};
-
         auto client = message.parameters[0];
-        auto token = message.parameters[1];
-        auto channel = message.parameters[2];
-        user.user = message.parameters[3];
-        user.ip = message.parameters[4];
-        user.host = message.parameters[5];
-        user.server = message.parameters[6];
-        user.nick = message.parameters[7];
-        user.flags = message.parameters[8];
-        user.hopcount = message.parameters[9];
-        user.idle = message.parameters[10];
-        user.account = message.parameters[11];
-        user.oplevel = message.parameters[12];
-        user.realname = message.parameters[13];
-
-        if (isChannel(channel))
-            ircChannels[toLower(channel)].nicks[toLower(user.nick)] = user;
+        std::string_view channel = message.parameters[2];
+        // Replies to our requests are correlated by token, the channel field
+        // may be "*" for members that are hidden
+        unsigned token = 0;
+        std::from_chars(message.parameters[1].data(), message.parameters[1].data() + message.parameters[1].size(), token);
+        auto request = std::find_if(mWhoInFlight.begin(), mWhoInFlight.end(),
+                                    [token](const WhoRequest &request) { return request.token && request.token == token; });
+        if (request != mWhoInFlight.end())
+            channel = mSymbols.name(request->channel);
+        if (isChannel(std::string(channel)) && message.parameters[7].length() && isJoined(channel)) {
+            auto &entry = this->user(message.parameters[7]);
+            auto &user = entry.second;
+            bool changed = setSymbol(user.user, message.parameters[3]);
+            user.ip = message.parameters[4];
+            changed |= setSymbol(user.host, message.parameters[5]);
+            setSymbol(user.server, message.parameters[6]);
+            user.hopcount = message.parameters[9];
+            user.idle = message.parameters[10];
+            // WHOX has "0" for users that are not logged in
+            changed |= setAccount(user, message.parameters[11] == "0" ? "*" : message.parameters[11]);
+            changed |= assign(user.realname, message.parameters[13]);
+            if (changed)
+                touchUser(user);
+            auto &member = addMember(channel, entry);
+            member.flags = message.parameters[8];
+            member.modes = prefixModes(member.flags);
+            member.oplevel = message.parameters[12];
+        }
     }
 }
 void IRC::onWhoReply(IRCMessage &message) {
     //   "<client> <channel> <username> <host> <server> <nick> <flags> :<hopcount>
     //   <realname>"
-    if (message.parameters.size() > 8) {
-        IRCUser user = {};
+    if (message.parameters.size() > 7) {
         auto client = message.parameters[0];
         auto channel = message.parameters[1];
-        user.user = message.parameters[2];
-        user.host = message.parameters[3];
-        user.server = message.parameters[4];
-        user.nick = message.parameters[5];
-        user.flags = message.parameters[6];
-        user.hopcount = message.parameters[7];
-        user.realname = message.parameters[8];
-
-        if (isChannel(channel))
-            ircChannels[toLower(channel)].nicks[toLower(user.nick)] = user;
+        if (isChannel(channel) && message.parameters[5].length() && isJoined(channel)) {
+            auto &entry = this->user(message.parameters[5]);
+            auto &user = entry.second;
+            bool changed = setSymbol(user.user, message.parameters[2]);
+            changed |= setSymbol(user.host, message.parameters[3]);
+            setSymbol(user.server, message.parameters[4]);
+            // The hopcount and realname share the trailing parameter
+            std::string_view trailing = message.parameters[7];
+            auto space = trailing.find(' ');
+            user.hopcount = trailing.substr(0, space);
+            changed |= assign(user.realname, space != std::string_view::npos ? trailing.substr(space + 1) : std::string_view());
+            if (changed)
+                touchUser(user);
+            auto &member = addMember(channel, entry);
+            member.flags = message.parameters[6];
+            member.modes = prefixModes(member.flags);
+        }
     }
 }
 
 void IRC::onEndOfWho(IRCMessage &message) {
+    // "<client> <mask> :End of WHO list"
+    if (message.parameters.size() > 1) {
+        auto symbol = findSymbol(message.parameters[1]);
+        auto request = std::find_if(mWhoInFlight.begin(), mWhoInFlight.end(),
+                                    [symbol](const WhoRequest &request) { return request.channel == symbol; });
+        if (symbol != SymbolTable::none && request != mWhoInFlight.end()) {
+            mWhoInFlight.erase(request);
+            auto it = ircChannels.find(symbol);
+            if (it != ircChannels.end())
+                it->second.who = WhoState::synced;
+            pumpWho();
+        }
+    }
 #ifdef ENABLE_LOG_DEBUG
     if (message.parameters.size() > 1) {
         // "<client> <mask> :End of WHO list"
         auto channel = toLower(message.parameters[1]);
-        if (isChannel(channel)) {
+        auto it = ircChannels.find(findSymbol(channel));
+        if (isChannel(channel) && it != ircChannels.end()) {
             LOG_DEBUG("Channel: %s", channel.c_str());
-            for (auto &nick : ircChannels[toLower(channel)].nicks) {
-                LOG_DEBUG("Nick: %s", nick.second.nick.c_str());
+            for (auto &nick : it->second.members) {
+                auto name = mSymbols.name(nick.first);
+                LOG_DEBUG("Nick: %.*s", (int)name.length(), name.data());
             }
         }
     }
@@ -1362,29 +2065,275 @@ void IRC::onNicknameInUse(IRCMessage &message) {
     if (!serverInfo.registrationComplete && Numeric::ERR_NICKNAMEINUSE == message.command) {
         // TODO, limit retries, make configurable
         mNick += "_";
+        publishTextBudget();
         send("NICK " + mNick);
         return;
     }
 }
 
-void IRC::onMessage(IRCMessage &message) {
+void IRC::onNICK(IRCMessage &message) {
+    // "NICK <nickname>", from the user changing their nick
+    if (message.parameters.size() > 0) {
+        renameUser(message.source.nick, message.parameters[0]);
+        if (isEqual(mNick, message.source.nick))
+            setOwnSource(message.parameters[0], mOwnUser, mOwnHost);
+    }
+}
+
+void IRC::onCHGHOST(IRCMessage &message) {
+    // https://ircv3.net/specs/extensions/chghost
+    // ":nick!old_user@old_host CHGHOST <new_user> <new_host>"
+    if (message.parameters.size() > 1) {
+        auto it = ircUsers.find(findSymbol(message.source.nick));
+        if (it != ircUsers.end() &&
+            (setSymbol(it->second.user, message.parameters[0]) | setSymbol(it->second.host, message.parameters[1])))
+            touchUser(it->second);
+        if (isEqual(mNick, message.source.nick))
+            setOwnSource(mNick, message.parameters[0], message.parameters[1]);
+    }
+}
+
+void IRC::onVisibleHost(IRCMessage &message) {
+    // "<client> <host> :is now your displayed host", the host may be given
+    // as user@host
+    if (message.parameters.size() > 1) {
+        std::string_view host = message.parameters[1];
+        auto at = host.find('@');
+        if (at != std::string_view::npos)
+            setOwnSource(mNick, host.substr(0, at), host.substr(at + 1));
+        else
+            setOwnSource(mNick, mOwnUser, host);
+    }
+}
+
+void IRC::setOwnSource(std::string_view nick, std::string_view user, std::string_view host) {
+    mNick = nick;
+    mOwnUser = user;
+    mOwnHost = host;
+    publishTextBudget();
+}
+
+void IRC::onMessage(IRCMessageView &view) {
+    static constexpr auto batchCode = IRCCommand::decode("BATCH");
+    bool mayBeBatched = mBatches.size() && view.tags.length() && view.code != batchCode;
+
+    auto &parser = mMessageParsers[view.code];
+    if (parser || mayBeBatched) {
+        // Only now we know the message is of interest, build the owning
+        // message the handlers operate on.
+        IRCMessage message = toMessage(view, &mArena);
+        if (mayBeBatched && collectBatched(message))
+            return;
+        if (parser)
+            parser(message);
+    }
+
+    if (mSubscriptions[view.code]) {
+        // The client asked for it, also when we handled it ourselves. The
+        // handler ran first, so our state already reflects the message.
+        std::map<std::string, std::string> m;
+        m["type"] = "irc";
+        m["irc/command"] = view.command;
+        m["irc/raw"] = view.raw;
+        m["sender/irc/raw"] = view.source.raw;
+        if (mClient)
+            mClient->onMessage(m);
+    }
+}
+
+void IRC::dispatch(IRCMessage &message) {
+    auto &parser = mMessageParsers[IRCCommand::decode(message.command)];
+    if (parser)
+        parser(message);
+}
+
+bool IRC::collectBatched(IRCMessage &message) {
+    auto reference = message.tags.get(IRCTags::HotTag::batch);
+    if (reference.empty())
+        return false;
+    auto batch = mBatches.find(reference);
+    if (batch == mBatches.end())
+        return false;
+    // The batch outlives this read, so this copy is made outside the arena
+    batch->second.messages.push_back(message);
+    if (batch->second.messages.size() >= batchMessageLimit) {
+        LOG_WARNING("Batch %s is full, processing it before it ends", batch->second.type.c_str());
+        // Keeps collecting into the same batch after this
+        IRCBatch full = {batch->second.type, batch->second.parameters, std::move(batch->second.messages)};
+        batch->second.messages.clear();
+        onBatchEnd(full);
+    }
+    return true;
+}
+
+void IRC::onBATCH(IRCMessage &message) {
+    // BATCH +<reference> <type> [<parameters>...]
+    // BATCH -<reference>
+    if (message.parameters.size() < 1 || message.parameters[0].length() < 2)
+        return;
+
+    auto reference = message.parameters[0].substr(1);
+    if (message.parameters[0][0] == '+') {
+        if (message.parameters.size() < 2)
+            return;
+        if (mBatches.size() >= batchOpenLimit && !mBatches.contains(reference)) {
+            auto oldest = mBatches.begin();
+            for (auto it = mBatches.begin(); it != mBatches.end(); it++)
+                if (it->second.order < oldest->second.order)
+                    oldest = it;
+            LOG_WARNING("Too many open batches, ending %s", oldest->first.c_str());
+            IRCBatch ended = std::move(oldest->second);
+            mBatches.erase(oldest);
+            onBatchEnd(ended);
+        }
+        IRCBatch &batch = mBatches[reference];
+        batch.order = mBatchOrder++;
+        batch.type = message.parameters[1];
+        batch.parameters.assign(message.parameters.begin() + 2, message.parameters.end());
+    } else if (message.parameters[0][0] == '-') {
+        auto batch = mBatches.find(reference);
+        if (batch == mBatches.end())
+            return;
+        IRCBatch ended = std::move(batch->second);
+        mBatches.erase(batch);
+        onBatchEnd(ended);
+    }
+}
 
-    if (mMessageParsers[message.command]) {
-        mMessageParsers[message.command](message);
+void IRC::onBatchEnd(IRCBatch &batch) {
+    LOG_DEBUG("Batch %s ended with %d messages", batch.type.c_str(), (int)batch.messages.size());
+    if (batch.type == "netsplit") {
+        onNetsplit(batch);
+    } else if (batch.type == "netjoin") {
+        onNetjoin(batch);
+    } else if (batch.type == "chathistory" || batch.type == "draft/chathistory") {
+        onChatHistory(batch);
     } else {
-        // Unknown message type
+        // No special handling for this type, process as if not batched
+        for (auto &message : batch.messages)
+            dispatch(message);
     }
 }
 
-void IRC::splitUserNickHost(IRCSource &source) {
-    auto userPos = source.raw.find("!");
-    auto hostPos = source.raw.find("@");
-    if (userPos != std::string::npos) {
+void IRC::onNetsplit(IRCBatch &batch) {
+    // BATCH +<reference> netsplit <server 1> <server 2>
+    // followed by a QUIT for every user that split off.
+    unsigned count = 0;
+    std::string nicks;
+    for (auto &message : batch.messages) {
+        if (message.command != "QUIT" || message.source.nick.empty())
+            continue;
+        count++;
+        // Only touches the channels the user was in
+        removeUser(findSymbol(message.source.nick));
+        if (nicks.length())
+            nicks += ' ';
+        nicks += message.source.nick;
+    }
+
+    std::map<std::string, std::string> m;
+    m["type"] = "netsplit";
+    m["irc/batch/count"] = std::to_string(count);
+    m["irc/batch/nicks"] = nicks;
+    if (batch.parameters.size() > 1) {
+        m["irc/batch/server1"] = batch.parameters[0];
+        m["irc/batch/server2"] = batch.parameters[1];
+    }
+    if (mClient)
+        mClient->onMessage(m);
+}
+
+void IRC::onNetjoin(IRCBatch &batch) {
+    // BATCH +<reference> netjoin <server 1> <server 2>
+    // followed by a JOIN for every channel a user that returned is in.
+    std::set<std::string> joins;
+    std::string nicks;
+    for (auto &message : batch.messages) {
+        if (message.command != "JOIN")
+            continue;
+        onJOIN(message);
+        if (joins.insert(toLower(message.source.nick)).second) {
+            if (nicks.length())
+                nicks += ' ';
+            nicks += message.source.nick;
+        }
+    }
+
+    std::map<std::string, std::string> m;
+    m["type"] = "netjoin";
+    m["irc/batch/count"] = std::to_string(joins.size());
+    m["irc/batch/nicks"] = nicks;
+    if (batch.parameters.size() > 1) {
+        m["irc/batch/server1"] = batch.parameters[0];
+        m["irc/batch/server2"] = batch.parameters[1];
+    }
+    if (mClient)
+        mClient->onMessage(m);
+}
+
+void IRC::onChatHistory(IRCBatch &batch) {
+    // BATCH +<reference> chathistory <target>
+    // History is not live traffic: it should not trigger any bot commands.
+    // It is passed on as a single event, one line per message.
+    std::string history;
+    unsigned count = 0;
+    for (auto &message : batch.messages) {
+        if ((message.command != "PRIVMSG" && message.command != "NOTICE") || message.parameters.size() < 2)
+            continue;
+        auto time = message.tags.get(IRCTags::HotTag::time);
+        if (time.length()) {
+            history.append(time);
+            history += ' ';
+        }
+        history += '<';
+        history.append(message.source.nick.length() ? message.source.nick : message.source.raw);
+        history += "> ";
+        history += stripFormatting(message.parameters[1]);
+        history += '\n';
+        count++;
+    }
+
+    std::map<std::string, std::string> m;
+    m["type"] = "history";
+    if (batch.parameters.size()) {
+        m["target"] = toLower(batch.parameters[0]);
+        m["target/irc"] = batch.parameters[0];
+    }
+    m["irc/batch/count"] = std::to_string(count);
+    m["text/plain"] = history;
+    if (mClient)
+        mClient->onMessage(m);
+}
+
+std::string_view IRC::commandOf(std::string_view line) {
+    // Skips the tags and source, without parsing them
+    std::string_view::size_type pos = 0;
+    auto skipToken = [&line, &pos]() {
+        pos = line.find(' ', pos);
+        if (pos == std::string_view::npos)
+            pos = line.length();
+        while (pos < line.length() && line[pos] == ' ')
+            pos++;
+    };
+    if (pos < line.length() && line[pos] == '@')
+        skipToken();
+    if (pos < line.length() && line[pos] == ':')
+        skipToken();
+    auto end = line.find(' ', pos);
+    if (end == std::string_view::npos)
+        end = line.length();
+    return line.substr(pos, end - pos);
+}
+
+void IRC::splitUserNickHost(IRCSourceView &source) {
+    auto userPos = source.raw.find('!');
+    auto hostPos = source.raw.find('@');
+    if (userPos != std::string_view::npos) {
         source.nick = source.raw.substr(0, userPos);
     } else {
         userPos = 0;
     }
-    if (hostPos != std::string::npos) {
+    if (hostPos != std::string_view::npos) {
         source.user = source.raw.substr(userPos + 1, hostPos - userPos - 1);
         hostPos++;
     } else {
@@ -1393,76 +2342,104 @@ void IRC::splitUserNickHost(IRCSource &source) {
     source.host = source.raw.substr(hostPos);
 }
 
-void IRC::parseMessage(std::string line) {
-    // LOG_DEBUG("%s", (">>> " + line).c_str());
-    LOG_DEBUG(">>> %s", line.c_str());
-    IRCMessage message;
-    message.raw = line;
-
-    std::string trailingParameter;
-
-    auto trailingParameterPos = line.find(" :");
-    if (trailingParameterPos != std::string::npos) {
-        if (line[0] == '@') {
-            // When tags are enabled, we might have a false positive
-            // when a source parameter is available
-            auto falsePositive = line.find(" ");
-            if (falsePositive == trailingParameterPos) {
-                auto lineWithoutTag = line.substr(trailingParameterPos + 2);
-                auto trainlingParameterPosWithoutTag = lineWithoutTag.find(" :");
-                if (trainlingParameterPosWithoutTag != std::string::npos)
-                    trailingParameterPos += 2 + lineWithoutTag.find(" :");
-                else
-                    trailingParameterPos = std::string::npos;
-            }
-        }
-
-        if (trailingParameterPos != std::string::npos) {
-            trailingParameter = line.substr(trailingParameterPos + 2);
-            line = line.substr(0, trailingParameterPos);
-        }
-    }
-
-    auto tokens = splitString(line);
+bool IRC::parseMessageView(std::string_view line, IRCMessageView &view) {
+    // https://modern.ircdocs.horse/#message-format
+    // [@tags] [:source] <command> <parameters>
+    view.raw = line;
+    view.tags = {};
+    view.source = {};
+    view.command = {};
+    view.code = IRCCommand::unknown;
+    view.parameterCount = 0;
+
+    std::string_view::size_type pos = 0;
+    auto skipSpaces = [&line, &pos]() {
+        while (pos < line.length() && line[pos] == ' ')
+            pos++;
+    };
+    auto nextToken = [&line, &pos, &skipSpaces]() {
+        skipSpaces();
+        auto start = pos;
+        pos = line.find(' ', start);
+        if (pos == std::string_view::npos)
+            pos = line.length();
+        return line.substr(start, pos - start);
+    };
 
     // Tags, Optional, IRCv3
     // https://defs.ircdocs.horse/defs/tags
-    if (tokens.size()) {
-        if (tokens[0][0] == '@') {
-            // message.tags = tokens[0];
-            // message.tags.erase(0, 1); // remove the '@'
+    if (line.length() && line[0] == '@')
+        view.tags = nextToken().substr(1);
 
-            message.tags = parseTags(tokens[0].substr(1));
-
-            tokens.erase(tokens.begin());
-        }
+    // Source, Optional, RFC 1459
+    skipSpaces();
+    if (pos < line.length() && line[pos] == ':') {
+        view.source.raw = nextToken().substr(1);
+        splitUserNickHost(view.source);
     }
 
-    // Source, Optional, RFC 1459
-    if (tokens.size()) {
-        if (tokens[0][0] == ':') {
-            message.source.raw = tokens[0];
-            message.source.raw.erase(0, 1); // remove the ':'
-            tokens.erase(tokens.begin());
+    // Command, RFC 1459
+    view.command = nextToken();
+    if (view.command.empty()) {
+        // Error, incorrectly formatted message
+        return false;
+    }
+    view.code = IRCCommand::decode(view.command);
 
-            splitUserNickHost(message.source);
+    // Parameters, the last one may be a trailing parameter, which can
+    // contain spaces.
+    while (true) {
+        skipSpaces();
+        if (pos >= line.length())
+            break;
+        if (line[pos] == ':') {
+            view.parameters[view.parameterCount++] = line.substr(pos + 1);
+            break;
         }
+        if (view.parameterCount == IRCMessageView::maxParameters - 1) {
+            // No room left, whatever remains is the last parameter
+            view.parameters[view.parameterCount++] = line.substr(pos);
+            break;
+        }
+        view.parameters[view.parameterCount++] = nextToken();
     }
+    return true;
+}
 
-    // Command, RFC 1459
-    if (tokens.size()) {
-        message.command = tokens[0];
-        tokens.erase(tokens.begin());
-    } else {
-        // Error, incorrectly formatted message
+IRC::IRCMessage IRC::toMessage(const IRCMessageView &view, const allocator_type &alloc) {
+    IRCMessage message(alloc);
+    message.raw = view.raw;
+    if (view.tags.length())
+        message.tags.parse(view.tags);
+    message.source.raw = view.source.raw;
+    message.source.nick = view.source.nick;
+    message.source.user = view.source.user;
+    message.source.host = view.source.host;
+    message.command = view.command;
+    message.parameters.reserve(view.parameterCount);
+    for (unsigned i = 0; i < view.parameterCount; i++)
+        message.parameters.emplace_back(view.parameters[i]);
+    return message;
+}
+
+void IRC::parseMessage(std::string_view line) {
+    LOG_DEBUG(">>> %.*s", (int)line.length(), line.data());
+
+    auto code = IRCCommand::decode(commandOf(line));
+    // While a batch is open, anything tagged might belong to it
+    bool mayBeBatched = mBatches.size() && line[0] == '@';
+    if (!mInterest[code] && !mayBeBatched) {
+        mDropped[code]++;
+        return;
     }
-    message.parameters = tokens;
-    if (trailingParameter.length())
-        message.parameters.push_back(trailingParameter);
-    onMessage(message);
+
+    IRCMessageView view;
+    if (parseMessageView(line, view))
+        onMessage(view);
 }
 
 void IRC::onData(std::vector<char> data) {
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
     /*
      * IRCv3 "Modern IRC Client Protocol" states
      * When reading messages from a stream, read the incoming data into a
@@ -1485,18 +2462,27 @@ void IRC::onData(std::vector<char> data) {
      * additional bytes.
      */
 
-    mBuffer.insert(mBuffer.end(), data.begin(), data.end());
+    const char *received = data.data();
+    size_t remaining = data.size();
+    while (remaining) {
+        size_t taken = mLineBuffer.append(received, remaining);
+        received += taken;
+        remaining -= taken;
 
-    while (true) {
-        std::string eolMarker = "\r\n";
-        auto end = std::search(mBuffer.begin(), mBuffer.end(), eolMarker.begin(), eolMarker.end());
-        if (end != mBuffer.end()) {
-            std::string message = std::string(mBuffer.begin(), end);
-            mBuffer.erase(mBuffer.begin(), end + 2);
-            parseMessage(message);
-        } else
-            break;
+        std::string_view line;
+        while (mLineBuffer.nextLine(line))
+            parseMessage(line);
     }
+
+    // Takes requests posted meanwhile, and catches up with a WHO timer that
+    // could not get the lock
+    pumpWho();
+
+    // Readers see the changes of all lines at once
+    publish();
+
+    // Everything allocated while processing this data is gone by now
+    mArena.reset();
 }
 
 void IRC::send(std::string message) {
@@ -1558,173 +2544,155 @@ bool IRC::validText(const std::string text) {
     return true;
 }
 
-std::string IRC::formatTags(std::map<std::string, std::string> tags) {
-    std::string result;
-    bool first = true;
-    for (auto &tag : tags) {
-        if (!first)
-            result += ";";
-        first = false;
-        result += encodeTagKey(tag.first);
-        if (tag.second.length())
-            result += "=" + encodeTagValue(tag.second);
-    }
-    return result;
-}
-
 void IRC::sendACTION(const std::string target, const std::string text, const std::map<std::string, std::string> tags) {
-    sendCTCPQuery(target, "ACTION", text); // TODO tags
+    if (validTarget(target) && validText(text))
+        sendText("PRIVMSG", target, text, tags, "ACTION");
 }
 
 void IRC::sendPRIVMSG(const std::string target, const std::string text, const std::map<std::string, std::string> tags) {
-    if (validTarget(target) && validText(text)) {
-        std::string msg;
-        if (serverInfo.capabilities.acknowledged.contains("message-tags") && tags.size()) {
-            // TODO: escape tags
-            // TODO: consider tags as key-value pairs?
-            // send("@" + tags + " PRIVMSG " + target + " :" + text);
-            msg = "@" + formatTags(tags) + " ";
-        }
-        msg += "PRIVMSG " + target + " :" + text;
-        send(msg);
-    }
+    if (validTarget(target) && validText(text))
+        sendText("PRIVMSG", target, text, tags);
 }
 
 void IRC::sendTAGMSG(const std::string target, const std::map<std::string, std::string> tags) {
     if (validTarget(target)) {
         std::string msg;
-        if (serverInfo.capabilities.acknowledged.contains("message-tags") && tags.size()) {
-            msg = "@" + formatTags(tags) + " TAGMSG " + target;
+        if (mMessageTags && tags.size()) {
+            msg += '@';
+            IRCTags::format(msg, tags);
+            msg += " TAGMSG " + target;
             send(msg);
         }
     }
 }
 
 void IRC::sendNOTICE(const std::string target, const std::string text, const std::map<std::string, std::string> tags) {
-    if (validTarget(target) && validText(text)) {
-        std::string msg;
-        if (serverInfo.capabilities.acknowledged.contains("message-tags") && tags.size()) {
-            msg = "@" + formatTags(tags) + " ";
-        }
-        msg += "NOTICE " + target + " :" + text;
-        send(msg);
+    if (validTarget(target) && validText(text))
+        sendText("NOTICE", target, text, tags);
+}
+
+void IRC::sendKICK(const std::string channel, const std::string nick, const std::string reason) {
+    if (validTarget(channel) && validTarget(nick) && nick.length() && validText(reason)) {
+        if (reason.length())
+            send("KICK " + channel + " " + nick + " :" + reason);
+        else
+            send("KICK " + channel + " " + nick);
     }
 }
+
+void IRC::sendMODE(const std::string target, const std::string modes) {
+    // The modes and their parameters, such as "+b *!*@host"
+    if (validTarget(target) && validText(modes) && modes.length())
+        send("MODE " + target + " " + modes);
+}
+
 void IRC::sendCTCPQuery(const std::string target, const std::string command, const std::string parameters) {
     // TODO tags
-    if (parameters.length())
-        sendPRIVMSG(target, "\01" + command + " " + parameters + "\01");
-    else
-        sendPRIVMSG(target, "\01" + command + "\01");
+    if (validTarget(target) && validText(parameters))
+        sendText("PRIVMSG", target, parameters, {}, command);
 }
+
 void IRC::sendCTCPResponse(const std::string target, const std::string command, const std::string parameters) {
     // TODO tags
-    if (parameters.length())
-        sendNOTICE(target, "\01" + command + " " + parameters + "\01");
-    else
-        sendNOTICE(target, "\01" + command + "\01");
+    if (validTarget(target) && validText(parameters))
+        sendText("NOTICE", target, parameters, {}, command);
 }
 
-std::map<std::string, std::string> IRC::parseTags(const std::string &tagString) {
-    std::map<std::string, std::string> result;
-    auto tags = splitString(tagString, ";");
-    for (auto &tag : tags) {
-        auto kv = splitString(tag, "=", 2);
-        std::string key, value;
-
-        // If the tag has a vendor prefix, it might be punycode encoded
-        // We might want to decode it. However, how likely is it to
-        // encounter such a tag. Therefore this is low priority.
-        if (kv.size() > 0)
-            key = decodeTagKey(kv[0]);
-
-        if (kv.size() > 1)
-            value = decodeTagValue(kv[1]);
-        result[key] = value;
-    }
-    return result;
-}
+void IRC::publishTextBudget() {
+    auto feature = [this](const char *name, size_t fallback) -> size_t {
+        auto it = serverInfo.features.find(name);
+        if (it != serverInfo.features.end()) {
+            size_t value = strtoul(it->second.c_str(), nullptr, 10);
+            if (value)
+                return value;
+        }
+        return fallback;
+    };
 
-// Parses negations from features (ISUPPORT) or capabilities (CAP *)
-std::vector<std::string> IRC::parseNegation(const std::vector<std::string> &tokens) {
-    std::vector<std::string> result;
-    for (auto &token : tokens) {
-        if (token.length() && token[0] == '-') {
-            result.push_back(token.substr(1));
+    // ":nick!user@host " and CRLF. Until the server has shown us our
+    // user and host, assume the longest it allows.
+    size_t user = mOwnUser.length() ? mOwnUser.length() : feature("USERLEN", 10) + 1;
+    size_t host = mOwnHost.length() ? mOwnHost.length() : feature("HOSTLEN", 63);
+    mRelayOverhead = 1 + mNick.length() + 1 + user + 1 + host + 1 + 2;
+    mLineLength = feature("LINELEN", serverInfo.maxLen > 0 ? serverInfo.maxLen : 512);
+    mMessageTags = serverInfo.capabilities.acknowledged.contains("message-tags");
+}
+
+size_t IRC::textBudget(std::string_view command, std::string_view target) {
+    size_t lineLength = mLineLength;
+    // "<command> <target> :"
+    size_t overhead = mRelayOverhead + command.length() + 1 + target.length() + 2;
+    return overhead < lineLength ? lineLength - overhead : 0;
+}
+
+void IRC::sendText(std::string_view command, const std::string &target, std::string_view text,
+                   const std::map<std::string, std::string> &tags, std::string_view ctcp) {
+    // Tags have a budget of their own, https://ircv3.net/specs/extensions/message-tags
+    // 4094 bytes for the tags we send, excluding the '@' and the space.
+    std::string tagBlock;
+    if (mMessageTags && tags.size()) {
+        IRCTags::format(tagBlock, tags);
+        if (tagBlock.length() > 4094) {
+            LOG_WARNING("Tags exceed 4094 bytes, sending without them");
+            tagBlock.clear();
         }
     }
-    return result;
-}
 
-// Parses Key-Value pairs from features (ISUPPORT) or capabilities (CAP *)
-// while leaving out negated keys
-std::map<std::string, std::string> IRC::parseKeyValue(const std::vector<std::string> &tokens) {
-    std::map<std::string, std::string> result;
+    size_t budget = textBudget(command, target);
+    // "\x01<ctcp> " and "\x01"
+    if (ctcp.length())
+        budget -= std::min(budget, ctcp.length() + 3);
 
-    std::string key, value;
-    for (auto &token : tokens) {
-        auto issignpos = token.find('=');
-        if (issignpos == std::string::npos) {
-            key = token;
-            value = "";
+    std::vector<std::string_view> lines;
+    IRCFormatting::split(text, budget, lines);
+    for (auto line : lines) {
+        std::string msg;
+        msg.reserve(tagBlock.length() + command.length() + target.length() + line.length() + ctcp.length() + 8);
+        if (tagBlock.length()) {
+            msg += '@';
+            msg += tagBlock;
+            msg += ' ';
+        }
+        msg += command;
+        msg += ' ';
+        msg += target;
+        msg += " :";
+        if (ctcp.length()) {
+            msg += '\x01';
+            msg += ctcp;
+            if (line.length()) {
+                msg += ' ';
+                msg += line;
+            }
+            msg += '\x01';
         } else {
-            key = token.substr(0, issignpos);
-            value = token.substr(issignpos + 1);
+            msg += line;
         }
-        LOG_DEBUG("key %s value %s", key.c_str(), value.c_str());
-        if (key.length() && key[0] != '-')
-            result[key] = value;
+        send(std::move(msg));
     }
-    return result;
 }
 
-// Escapes Tag Values
-std::string IRC::encodeTagValue(const std::string &rawString) {
-    // TODO: Implement me
-    /*
-     * https://ircv3.net/specs/extensions/message-tags
-    ; (semicolon)  \: (backslash and colon)
-    SPACE          \s
-    \ 	           \\
-    CR 	           \r
-    LF 	           \n
-     */
-
-    return rawString;
-}
-
-// Unescapes Tag Values
-std::string IRC::decodeTagValue(const std::string &escapedString) {
-    // TODO: Implement me
-    /*
-     * https://ircv3.net/specs/extensions/message-tags
-    ; (semicolon)  \: (backslash and colon)
-    SPACE          \s
-    \ 	           \\
-    CR 	           \r
-    LF 	           \n
-
-    If a lone \ exists at the end of an escaped value (with no escape character
-    following it), then there SHOULD be no output character. For example, the
-    escaped value test\ should unescape to test. If a \ exists with no valid
-    escape character (for example, \b), then the invalid backslash SHOULD be
-    dropped. For example, \b should unescape to just b.
-     */
-
-    return escapedString;
-}
-
-std::string IRC::encodeTagKey(const std::string &rawString) {
-    // A non-ascii key needs to be punycode encoded
-    // TODO: priority: low
-    return rawString;
-}
+// Applies a token from features (ISUPPORT) or capabilities (CAP *) to the
+// map: "KEY" and "KEY=VALUE" set the key, a negated "-KEY" removes it.
+void IRC::applyKeyValue(std::map<std::string, std::string, std::less<>> &map, std::string_view token) {
+    if (token.empty())
+        return;
+    if (token[0] == '-') {
+        auto it = map.find(token.substr(1));
+        if (it != map.end())
+            map.erase(it);
+        return;
+    }
 
-std::string IRC::decodeTagKey(const std::string &escapedString) {
-    // Vendor Keys Prefixes, if not ascii, are punycode encoded
-    // May need to decode.
-    // TODO: priority: low
-    return escapedString;
+    std::string_view key = token, value;
+    auto issignpos = token.find('=');
+    if (issignpos != std::string_view::npos) {
+        key = token.substr(0, issignpos);
+        value = token.substr(issignpos + 1);
+    }
+    LOG_DEBUG("key %.*s value %.*s", (int)key.length(), key.data(), (int)value.length(), value.data());
+    if (key.length())
+        map.insert_or_assign(std::string(key), std::string(value));
 }
 
 // Convert IRC messages to generic format used by the Client class
@@ -1756,13 +2724,18 @@ std::map<std::string, std::string> IRC::messageToClient(IRCMessage &message) {
         result["sender/irc/user"] = message.source.user;
     if (message.source.host.length())
         result["sender/irc/host"] = message.source.host;
-    if (message.tags.contains("account"))
-        result["sender/irc/account"] = message.tags["account"];
+    if (message.tags.contains(IRCTags::HotTag::account))
+        result["sender/irc/account"] = message.tags.get(IRCTags::HotTag::account);
 
     result["sender/irc/raw"] = message.source.raw;
-
-    for (auto &tag : message.tags) {
-        result["irc/tag/" + tag.first] = tag.second;
+    // Our own message, as echoed by a server with echo-message
+    if (message.source.nick.length() && isEqual(mNick, message.source.nick))
+        result["echo"] = "true";
+
+    for (auto tag : message.tags) {
+        std::string key = "irc/tag/";
+        key += tag.key;
+        result[key] = tag.value;
     }
     return result;
 }
@@ -1791,6 +2764,19 @@ void IRC::sendMessage(std::map<std::string, std::string> message) {
             if (message["type"] == "action") {
                 sendACTION(message["target"], text);
             }
+            if (message["type"] == "kick") {
+                sendKICK(message["target"], message["nick"], text);
+            }
+            if (message["type"] == "mode") {
+                sendMODE(message["target"], message["mode"]);
+            }
+            if (message["type"] == "who") {
+                // A client moves a channel it is interested in to the front
+                // of the WHO queue. Clients may call from any thread, so
+                // the queue takes it with the next received data.
+                std::lock_guard<std::mutex> lock(mWhoPostedMutex);
+                mWhoPosted.push_back(message["target"]);
+            }
         }
     }
 }
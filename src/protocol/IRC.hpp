@@ -29,27 +29,51 @@
 #ifndef PROTOCOL_IRC_HPP_
 #define PROTOCOL_IRC_HPP_
 
+#include <array>
+#include <atomic>
+#include <bitset>
 #include <functional>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <set>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "C2SProtocol.hpp"
+#include "ChannelSnapshot.hpp"
 #include "Connection.hpp"
+#include "IRCCommand.hpp"
+#include "IRCFormatting.hpp"
+#include "IRCTags.hpp"
+#include "caseMapping.hpp"
+#include "lineBuffer.hpp"
+#include "lruCache.hpp"
+#include "messageArena.hpp"
+#include "symbolTable.hpp"
 #include "timer.hpp"
 
 namespace geblaat {
 
 class IRC : public C2SProtocol {
   public:
+    // IRCSource and IRCMessage are allocator aware. While processing received
+    // data they are allocated from the per-read MessageArena.
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
     struct IRCSource {
-        std::string raw;
+        using allocator_type = IRC::allocator_type;
+        explicit IRCSource(const allocator_type &alloc = {}) : raw(alloc), nick(alloc), user(alloc), host(alloc) {}
+
+        std::pmr::string raw;
         // source is split up into nick, user and host
-        std::string nick;
-        std::string user;
-        std::string host;
+        std::pmr::string nick;
+        std::pmr::string user;
+        std::pmr::string host;
     };
 
     struct IRCtag {
@@ -58,11 +82,37 @@ class IRC : public C2SProtocol {
     };
 
     struct IRCMessage {
-        std::string raw;
-        std::map<std::string, std::string> tags;
+        using allocator_type = IRC::allocator_type;
+        explicit IRCMessage(const allocator_type &alloc = {}) : raw(alloc), tags(alloc), source(alloc), parameters(alloc) {}
+
+        std::pmr::string raw;
+        IRCTags tags;
         IRCSource source;
         std::string command;
-        std::vector<std::string> parameters;
+        std::pmr::vector<std::string> parameters;
+    };
+
+    // Non-owning counterparts of IRCSource and IRCMessage. All members point
+    // into the received line and are only valid while that line is being
+    // processed. Use toMessage() to obtain an owning IRCMessage.
+    struct IRCSourceView {
+        std::string_view raw;
+        std::string_view nick;
+        std::string_view user;
+        std::string_view host;
+    };
+
+    struct IRCMessageView {
+        // RFC 1459: at most 14 middle parameters plus the trailing one
+        static constexpr unsigned maxParameters = 15;
+
+        std::string_view raw;
+        std::string_view tags; // without the leading '@'
+        IRCSourceView source;
+        std::string_view command;
+        IRCCommand::Code code = IRCCommand::unknown;
+        std::array<std::string_view, maxParameters> parameters;
+        unsigned parameterCount = 0;
     };
 
     struct CTCPMessage {
@@ -150,6 +200,7 @@ class IRC : public C2SProtocol {
         static constexpr const char *RPL_YOUREOPER = "381";
         static constexpr const char *RPL_REHASHING = "382";
         static constexpr const char *RPL_TIME = "391";
+        static constexpr const char *RPL_VISIBLEHOST = "396";
         static constexpr const char *ERR_UNKNOWNERROR = "400";
         static constexpr const char *ERR_NOSUCHNICK = "401";
         static constexpr const char *ERR_NOSUCHSERVER = "402";
@@ -258,32 +309,67 @@ class IRC : public C2SProtocol {
         static constexpr const char *IRCERR_UNKNOWNERROR = "999";
     };
 
+    using Symbol = SymbolTable::Symbol;
+
+    // Identifiers are interned in mSymbols, every symbol held here owns a
+    // reference to it.
+    // One record per user, shared by all channels the user is in. It holds
+    // a reference to its nick and the symbols below.
     struct IRCUser {
-        std::string user;
+        Symbol user = SymbolTable::none;
+        Symbol host = SymbolTable::none;
+        Symbol server = SymbolTable::none;
+        Symbol account = SymbolTable::none;
+        // Whether we know the account, none then means not logged in
+        bool accountKnown = false;
         std::string ip;
-        std::string host;
-        std::string server;
-        std::string nick;
-        std::string flags;
         std::string hopcount;
         std::string idle;
-        std::string account;
-        std::string oplevel;
         std::string realname;
+        // The channels the user is in, by name symbol. Users are in a
+        // handful of channels, so a vector beats a set here.
+        std::vector<Symbol> channels;
+        // As last published, reset when the user changes
+        std::shared_ptr<const UserSnapshot> snapshot;
     };
 
+    // What is specific to a user in one channel
+    struct IRCMember {
+        std::string flags;
+        std::string oplevel;
+        // Membership modes like o and v, by their rank in PREFIX. Bit 0 is
+        // the highest rank.
+        uint32_t modes = 0;
+    };
+
+    enum class WhoState : uint8_t { none, queued, sent, synced };
+
     struct IRCChannel {
-        bool joined;
+        bool joined = false;
         std::string name; // preserves case
         std::string topic;
         std::string topicStripped;
         std::string topicNick;
-        time_t topicSetAt;
-        unsigned token;
-        std::map<std::string, IRCUser> nicks;
+        time_t topicSetAt = 0;
+        // The token of the last WHOX request for the channel
+        unsigned token = 0;
+        WhoState who = WhoState::none;
+        // Changed since the last publish
+        bool changed = false;
+        // Keyed by the nick symbol, the user is found in ircUsers
+        std::unordered_map<Symbol, IRCMember> members;
+        // NAMES replies are collected here and replace the members at
+        // RPL_ENDOFNAMES, so members is never half built. Every staged nick
+        // holds a reference, so its symbol is not reused meanwhile.
+        std::unordered_map<Symbol, IRCMember> staging;
+
+        // Modes without a parameter (type D), by character
+        std::bitset<256> modes;
+        // Modes with a parameter (types B and C), like the key and limit
+        std::vector<std::pair<char, std::string>> settings;
+        // List modes (type A), like bans, as far as we have seen them change
+        std::vector<std::pair<char, std::set<std::string, std::less<>>>> lists;
     };
-    std::map<std::string, IRCChannel> ircChannels;
-
     IRC();
     ~IRC();
 
@@ -298,12 +384,87 @@ class IRC : public C2SProtocol {
     nlohmann::json config;
 
     using IRCMessageParser = std::function<void(IRCMessage &message)>;
-    std::map<std::string, IRCMessageParser> mMessageParsers;
+
+    // Handlers indexed by command code. Handlers are registered by command
+    // name, which is decoded once at registration. A command missing from
+    // the command table is refused, it would share the slot of every other
+    // unknown command.
+    class MessageParsers {
+      public:
+        IRCMessageParser &operator[](std::string_view command);
+        IRCMessageParser &operator[](IRCCommand::Code code) { return mParsers[code]; }
+        bool contains(IRCCommand::Code code) const { return bool(mParsers[code]); }
+
+      private:
+        std::array<IRCMessageParser, IRCCommand::count> mParsers;
+        // Takes refused handlers, never dispatched
+        IRCMessageParser mRefused;
+    };
+    MessageParsers mMessageParsers;
+
+    // Commands we have a handler for or that have been subscribed to. Lines
+    // carrying any other command are dropped before they are parsed, and
+    // counted per command.
+    std::bitset<IRCCommand::count> mInterest;
+    std::bitset<IRCCommand::count> mSubscriptions;
+    std::array<uint64_t, IRCCommand::count> mDropped = {};
+    void updateInterest(void);
+    static std::string_view commandOf(std::string_view line);
 
     Timer connectTimer;
     Timer lagTimer;
 
-    std::vector<char> mBuffer;
+    // Held while processing received data and by the WHO timer, which runs
+    // on a thread of its own
+    std::recursive_mutex mMutex;
+    bool mClosing = false;
+
+    // WHO requests are queued per channel after NAMES and sent within a
+    // budget: a number of requests awaiting their replies, and a minimum
+    // interval between them. Priority channels go first, then smaller
+    // ones. Replies and a timer drive the queue, the timer when waiting for
+    // the interval or a request that is not answered. Replies to WHOX
+    // requests are matched to them by token.
+    using QueuedWho = std::tuple<size_t, uint64_t, Symbol>; // priority, order, channel
+    // A heap, lowest first
+    std::vector<QueuedWho> mWhoQueue;
+    struct WhoRequest {
+        Symbol channel;
+        unsigned token;
+        std::chrono::steady_clock::time_point sent;
+    };
+    std::vector<WhoRequest> mWhoInFlight;
+    size_t mWhoInFlightLimit = 1;
+    std::chrono::milliseconds mWhoInterval{500};
+    std::vector<std::string> mWhoPriority;
+    std::chrono::steady_clock::time_point mWhoNext;
+    unsigned mWhoToken = 0;
+    uint64_t mWhoOrder = 0;
+    Timer whoTimer;
+    // When the timer is armed for, the epoch when it is not
+    std::chrono::steady_clock::time_point mWhoWake;
+    // Channels clients asked for, from any thread, taken by pumpWho
+    std::mutex mWhoPostedMutex;
+    std::vector<std::string> mWhoPosted;
+    // Time to synced state, from the first queued request until the queue
+    // has drained
+    bool mSyncing = false;
+    std::chrono::steady_clock::time_point mSyncStart;
+    unsigned mSyncRequests = 0;
+    unsigned mSyncSkipped = 0;
+    void queueWho(Symbol symbol, IRCChannel &channel, bool priority = false);
+    void pumpWho(void);
+    void armWho(std::chrono::steady_clock::time_point now);
+    void onWhoTimer(void);
+    void resetWho(void);
+    // Takes a channel we leave out of the queue and the requests in flight
+    void forgetWho(Symbol channel);
+    // With extended-join and account-notify, a channel whose members are
+    // all known needs no WHO
+    bool whoComplete(const IRCChannel &channel);
+
+    LineBuffer mLineBuffer;
+    MessageArena mArena;
 
     //------------------------------------------------------------------------
     // Todo refactor this into a struct or something
@@ -354,11 +515,11 @@ class IRC : public C2SProtocol {
         std::string services;
         std::string servicesFamily;
 
-        std::map<std::string, std::string> features;
+        std::map<std::string, std::string, std::less<>> features;
 
         struct {
-            std::map<std::string, std::string> supported;
-            std::set<std::string> acknowledged;
+            std::map<std::string, std::string, std::less<>> supported;
+            std::set<std::string, std::less<>> acknowledged;
         } capabilities;
 
         struct {
@@ -369,10 +530,14 @@ class IRC : public C2SProtocol {
         } extensions;
 
         std::chrono::milliseconds lag;
+        // How long the last round of WHO requests took to complete
+        std::chrono::milliseconds syncTime{0};
     } serverInfo;
 
-    void parseMessage(std::string message);
-    void onMessage(IRCMessage &message);
+    void parseMessage(std::string_view line);
+    static bool parseMessageView(std::string_view line, IRCMessageView &view);
+    IRCMessage toMessage(const IRCMessageView &view, const allocator_type &alloc = {});
+    void onMessage(IRCMessageView &view);
     void send(std::string message);
 
     void onISupport(IRCMessage &message);
@@ -398,6 +563,10 @@ class IRC : public C2SProtocol {
     void onTAGMSG(IRCMessage &message);
     void onNOTICE(IRCMessage &message);
     void onJOIN(IRCMessage &message);
+    void onPART(IRCMessage &message);
+    void onKICK(IRCMessage &message);
+    void onQUIT(IRCMessage &message);
+    void onACCOUNT(IRCMessage &message);
     void onMODE(IRCMessage &message);
 
     void onTopic(IRCMessage &message);
@@ -413,33 +582,167 @@ class IRC : public C2SProtocol {
     void onCTCPResponse(IRCMessage &message, CTCPMessage &ctcp);
 
     void onNicknameInUse(IRCMessage &message);
+    void onNICK(IRCMessage &message);
+    void onCHGHOST(IRCMessage &message);
+    void onVisibleHost(IRCMessage &message);
+
+    // IRCv3 batches, https://ircv3.net/specs/extensions/batch
+    // Messages carrying the reference tag of an open batch are collected
+    // and processed together when the batch ends. A server that never ends
+    // a batch cannot make us hold on to its messages: a full batch is
+    // processed with what it has so far, and opening one too many ends the
+    // oldest.
+    struct IRCBatch {
+        std::string type;
+        std::vector<std::string> parameters;
+        std::vector<IRCMessage> messages;
+        uint64_t order = 0;
+    };
+    std::map<std::string, IRCBatch, std::less<>> mBatches;
+    uint64_t mBatchOrder = 0;
+    static constexpr size_t batchOpenLimit = 16;
+    static constexpr size_t batchMessageLimit = 10000;
+
+    bool collectBatched(IRCMessage &message);
+    void onBATCH(IRCMessage &message);
+    void onBatchEnd(IRCBatch &batch);
+    void onNetsplit(IRCBatch &batch);
+    void onNetjoin(IRCBatch &batch);
+    void onChatHistory(IRCBatch &batch);
+    void dispatch(IRCMessage &message);
 
     void sendPRIVMSG(const std::string target, const std::string text, const std::map<std::string, std::string> tags = {});
     void sendACTION(const std::string target, const std::string text, const std::map<std::string, std::string> tags = {});
     void sendTAGMSG(const std::string target, const std::map<std::string, std::string> tags = {});
     void sendNOTICE(const std::string target, const std::string text, const std::map<std::string, std::string> tags = {});
+    void sendKICK(const std::string channel, const std::string nick, const std::string reason = "");
+    void sendMODE(const std::string target, const std::string modes);
     void sendCTCPQuery(const std::string target, const std::string command, const std::string parameters = "");
     void sendCTCPResponse(const std::string target, const std::string command, const std::string parameters = "");
 
+    // Sends text as PRIVMSG or NOTICE, split over as many lines as needed
+    // to fit when relayed by the server. With ctcp set, every line is sent
+    // as that CTCP command.
+    void sendText(std::string_view command, const std::string &target, std::string_view text,
+                  const std::map<std::string, std::string> &tags, std::string_view ctcp = {});
+    // Bytes available for the text of a relayed PRIVMSG or NOTICE
+    size_t textBudget(std::string_view command, std::string_view target);
+    // Our own user and host as the server relays our messages with them
+    void setOwnSource(std::string_view nick, std::string_view user, std::string_view host);
+    std::string mOwnUser;
+    std::string mOwnHost;
+    // What sending text depends on, determined on the receive thread whenever
+    // it changes so senders on other threads only read these
+    void publishTextBudget();
+    // Length of the relayed ":nick!user@host " plus CRLF
+    std::atomic<size_t> mRelayOverhead = 0;
+    std::atomic<size_t> mLineLength = 512;
+    std::atomic<bool> mMessageTags = false;
+
     bool isNick(const std::string target);
     bool isChannel(const std::string target);
 
     bool validTarget(const std::string target);
     bool validText(const std::string text);
 
-    bool isEqual(const std::string first, const std::string seccond);
-    std::string toLower(std::string str);
-
-    std::string stripFormatting(const std::string &formattedString);
-    void splitUserNickHost(IRCSource &source);
-    std::map<std::string, std::string> parseTags(const std::string &tagString);
-    std::string formatTags(std::map<std::string, std::string> tags);
-    std::map<std::string, std::string> parseKeyValue(const std::vector<std::string> &);
-    std::vector<std::string> parseNegation(const std::vector<std::string> &);
-    std::string encodeTagValue(const std::string &);
-    std::string decodeTagValue(const std::string &);
-    std::string encodeTagKey(const std::string &);
-    std::string decodeTagKey(const std::string &);
+    CaseMapping mCaseMapping;
+    // Identifiers folded with the UTF8 mapping, nicks and channels repeat
+    LRUCache mFoldCache;
+    SymbolTable mSymbols{mCaseMapping};
+    // Interns a nick, channel or host. With the UTF8 mapping, names are
+    // folded first, as the symbol table only applies the byte mapping.
+    Symbol intern(std::string_view name);
+    Symbol findSymbol(std::string_view name);
+    // Only the protocol thread touches these, others read the snapshots
+    // Keyed by the channel name symbol
+    std::unordered_map<Symbol, IRCChannel> ircChannels;
+    // Keyed by the nick symbol, users are dropped when they leave their
+    // last channel
+    std::unordered_map<Symbol, IRCUser> ircUsers;
+    // Looks up a channel, adding it when it is not known yet
+    IRCChannel &channel(std::string_view name);
+
+    // Replaces the symbol in field by the one for name, an empty name
+    // leaves it as it is. Returns whether the field changed.
+    bool setSymbol(Symbol &field, std::string_view name);
+    // Sets the account of a user, "*" when not logged in, as extended-join
+    // and ACCOUNT give it. Returns whether it changed.
+    bool setAccount(IRCUser &user, std::string_view account);
+    // A message from a user we know shows its user and host, and with
+    // account-tag its account, all of which may save a WHO
+    void updateUser(IRCMessage &message);
+    // Looks up a user by nick, adding it when it is not known yet
+    std::pair<const Symbol, IRCUser> &user(std::string_view nick);
+    // Adds the user to the channel, or returns the existing membership
+    IRCMember &addMember(std::string_view channel, std::pair<const Symbol, IRCUser> &user);
+    // These only touch the channels the user is in
+    void removeMember(Symbol channel, Symbol nick);
+    // Removes the channel from the channels of the user, and the user when
+    // that was the last one. The membership itself is left alone.
+    void leaveChannel(Symbol nick, Symbol channel);
+    void removeUser(Symbol nick);
+    void renameUser(std::string_view nick, std::string_view newNick);
+    // Forgets a channel we are no longer in, with its members
+    void removeChannel(Symbol channel);
+    // Replaces the members of a channel by the ones staged from NAMES
+    void commitNames(Symbol symbol, IRCChannel &channel);
+    // Drops what was staged, with the users that are in no channel
+    void discardNames(Symbol symbol, IRCChannel &channel);
+    // The channels with a non-empty staging set, few at any time
+    std::vector<Symbol> mStagingChannels;
+    std::pair<const Symbol, IRCChannel> &channelEntry(std::string_view name);
+    // Whether we are in the channel, without adding it
+    bool isJoined(std::string_view name);
+
+    // Channel modes by character, compiled from CHANMODES and PREFIX, so a
+    // MODE takes a single lookup per character
+    enum class ModeType : uint8_t { unknown, list, setting, parameter, flag, membership };
+    struct ModeClass {
+        ModeType type = ModeType::unknown;
+        // For membership modes, the rank in PREFIX
+        uint8_t rank = 0;
+    };
+    std::array<ModeClass, 256> mModeClasses{};
+    // The rank in PREFIX plus one by prefix character, 0 for others
+    std::array<uint8_t, 256> mPrefixRanks{};
+    // The membership modes of the prefixes in WHO flags or a NAMES entry
+    uint32_t prefixModes(std::string_view prefixes);
+    // Applies the modestring at parameters[first] with its arguments
+    void applyModes(IRCChannel &channel, const std::pmr::vector<std::string> &parameters, size_t first);
+    // The prefixes by rank, as in PREFIX
+    std::string mPrefixes;
+
+    // The channels are published as snapshots after received data has been
+    // processed. Changed channels are rebuilt, the others are shared with
+    // the previous snapshots.
+    std::atomic<std::shared_ptr<const ChannelSnapshots>> mSnapshots;
+    std::vector<Symbol> mChangedChannels;
+    // Keys of channels we left
+    std::vector<std::string> mRemovedChannels;
+    // Rebuild all, after the casemapping or PREFIX changed
+    bool mRepublish = false;
+    void touch(Symbol symbol, IRCChannel &channel);
+    // A change to a user changes all channels the user is in
+    void touchUser(IRCUser &user);
+    std::shared_ptr<const ChannelSnapshot> snapshot(Symbol symbol, IRCChannel &channel);
+    void publish(void);
+    void configureCaseMapping(void);
+    bool isEqual(std::string_view first, std::string_view seccond);
+    std::string toLower(std::string_view str);
+
+    std::string stripFormatting(std::string_view formattedString);
+    // Passes a message with text to the client. Only the renderings named
+    // in the configuration are added to the message, the client asks for
+    // others through text() while it handles the message.
+    void textToClient(std::map<std::string, std::string> &m, FormattedText &text);
+    bool mRenderPlain = false;
+    bool mRenderIRC = false;
+    bool mRenderANSI = false;
+    bool mRenderHTML = false;
+    // The text of the message being passed to the client
+    FormattedText *mText = nullptr;
+    static void splitUserNickHost(IRCSourceView &source);
+    static void applyKeyValue(std::map<std::string, std::string, std::less<>> &map, std::string_view token);
 
     void requestCapabilityIfPresent(const std::string &);
 
@@ -447,8 +750,14 @@ class IRC : public C2SProtocol {
 
     std::map<std::string, std::string> messageToClient(IRCMessage &message);
 
+    // Microbenchmarks, src/bench
+    friend struct IRCBench;
+
   public:
     void sendMessage(std::map<std::string, std::string> message) override;
+    std::shared_ptr<const ChannelSnapshots> channels(void) override;
+    std::string_view text(std::string_view format) override;
+    void subscribe(const std::string &command) override;
 };
 
 } // namespace geblaat
@@ -0,0 +1,121 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef PROTOCOL_IRCCOMMAND_HPP_
+#define PROTOCOL_IRCCOMMAND_HPP_
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+namespace geblaat {
+
+namespace ircCommandDetail {
+// Named commands we may receive from a server.
+inline constexpr std::string_view verbs[] = {
+    "ACCOUNT", "AUTHENTICATE", "AWAY", "BATCH", "CAP",     "CHGHOST", "ERROR",   "FAIL",   "INVITE", "JOIN",    "KICK",
+    "KILL",    "MODE",         "NICK", "NOTE",  "NOTICE",  "PART",    "PING",    "PONG",   "PRIVMSG", "QUIT",   "SETNAME",
+    "TAGMSG",  "TOPIC",        "WALLOPS", "WARN",
+};
+
+inline constexpr size_t slotCount = 128;
+
+// FNV-1a, with a seed chosen such it has no collisions for our verbs
+constexpr uint32_t hash(std::string_view s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : s)
+        h = (h ^ (uint8_t)c) * 16777619u;
+    return h;
+}
+
+constexpr bool isPerfect(uint32_t seed) {
+    std::array<bool, slotCount> used = {};
+    for (auto verb : verbs) {
+        auto slot = hash(verb, seed) % slotCount;
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findSeed(void) {
+    uint32_t seed = 0;
+    while (!isPerfect(seed))
+        seed++;
+    return seed;
+}
+
+// A slot contains the index of the verb plus one, zero for an empty slot
+constexpr std::array<uint8_t, slotCount> buildSlots(uint32_t seed) {
+    std::array<uint8_t, slotCount> slots = {};
+    for (size_t i = 0; i < std::size(verbs); i++)
+        slots[hash(verbs[i], seed) % slotCount] = i + 1;
+    return slots;
+}
+
+inline constexpr uint32_t seed = findSeed();
+inline constexpr std::array<uint8_t, slotCount> verbSlots = buildSlots(seed);
+} // namespace ircCommandDetail
+
+// Decodes the command of an IRC message into a compact code, so handlers
+// can be found by indexing rather than by string comparison.
+// The three digit numerics map onto 0-999, the named commands onto the
+// codes following that. Anything else decodes to IRCCommand::unknown.
+struct IRCCommand {
+    using Code = uint16_t;
+
+    static constexpr Code numericCount = 1000;
+    static constexpr Code verbCount = std::size(ircCommandDetail::verbs);
+    static constexpr Code unknown = numericCount + verbCount;
+    static constexpr Code count = unknown + 1;
+
+    static constexpr Code decode(std::string_view command) {
+        if (command.length() == 3 && isDigit(command[0]) && isDigit(command[1]) && isDigit(command[2]))
+            return (command[0] - '0') * 100 + (command[1] - '0') * 10 + (command[2] - '0');
+
+        using namespace ircCommandDetail;
+        auto verb = verbSlots[hash(command, seed) % slotCount];
+        if (verb && command == verbs[verb - 1])
+            return numericCount + verb - 1;
+        return unknown;
+    }
+
+    static constexpr std::string_view verb(Code code) {
+        if (code >= numericCount && code < unknown)
+            return ircCommandDetail::verbs[code - numericCount];
+        return {};
+    }
+
+  private:
+    static constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+};
+
+} // namespace geblaat
+#endif /* PROTOCOL_IRCCOMMAND_HPP_ */
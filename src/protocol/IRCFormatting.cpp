@@ -0,0 +1,447 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "IRCFormatting.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace geblaat {
+
+size_t IRCFormatting::findControl(std::string_view text, size_t from) {
+    if (from >= text.length())
+        return std::string_view::npos;
+    const char *data = text.data() + from;
+    size_t length = text.length() - from;
+
+    // A byte is below 0x20 when the unsigned minimum of it and 0x1F is
+    // the byte itself
+#if defined(__AVX2__)
+    const __m256i limit32 = _mm256_set1_epi8(0x1f);
+    while (length >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(block, limit32), block));
+        if (mask)
+            return data - text.data() + std::countr_zero(mask);
+        data += 32;
+        length -= 32;
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i limit16 = _mm_set1_epi8(0x1f);
+    while (length >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(block, limit16), block));
+        if (mask)
+            return data - text.data() + std::countr_zero(mask);
+        data += 16;
+        length -= 16;
+    }
+#endif
+    for (; length; data++, length--) {
+        if ((unsigned char)*data < 0x20)
+            return data - text.data();
+    }
+    return std::string_view::npos;
+}
+
+size_t IRCFormatting::parameterLength(std::string_view text, size_t pos) {
+    auto isDigit = [&](size_t at) { return at < text.length() && text[at] >= '0' && text[at] <= '9'; };
+    auto isHex = [&](size_t at) { return at < text.length() && isxdigit((unsigned char)text[at]); };
+    auto isHexColour = [&](size_t at) {
+        for (size_t i = 0; i < 6; i++)
+            if (!isHex(at + i))
+                return false;
+        return true;
+    };
+
+    size_t next = pos + 1;
+    switch ((unsigned char)text[pos]) {
+    case color:
+        /*
+          Forms of Color Codes
+
+          In the following list, <CODE> represents the color formatting character (0x03),
+          <COLOR> represents one or two ASCII digits (either 0-9 or 00-99).
+
+          The use of this code can take on the following forms:
+
+          <CODE> - Reset foreground and background colors.
+          <CODE>, - Reset foreground and background colors and display the , character as
+          text. <CODE><COLOR> - Set the foreground color. <CODE><COLOR>, - Set the
+          foreground color and display the , character as text. <CODE><COLOR>,<COLOR> -
+          Set the foreground and background color.
+        */
+        // A comma not followed by a digit is text
+        if (isDigit(next)) {
+            next += isDigit(next + 1) ? 2 : 1;
+            if (next < text.length() && text[next] == ',' && isDigit(next + 1))
+                next += isDigit(next + 2) ? 3 : 2;
+        }
+        break;
+    case hexcolor:
+        /*
+          Keep the Forms of Color Codes section above in mind, as this method of
+          formatting keeps these same rules – the exceptions being that <CODE>
+          represents the hex color character (0x04) and <COLOR> represents a
+          six-digit hex value as RRGGBB.
+        */
+        if (isHexColour(next)) {
+            next += 6;
+            if (next < text.length() && text[next] == ',' && isHexColour(next + 1))
+                next += 7;
+        }
+        break;
+    case texticon:
+        // KvIRC extension, the icon name runs up to and including the next
+        // space, or the end of the text
+        next = text.find(' ', next);
+        next = next == std::string_view::npos ? text.length() : next + 1;
+        break;
+    default:
+        break;
+    }
+    return next - pos - 1;
+}
+
+std::string_view IRCFormatting::strip(std::string_view text, std::string &storage) {
+    size_t control = findControl(text);
+    if (control == std::string_view::npos)
+        return text;
+
+    storage.clear();
+    storage.reserve(text.length());
+    size_t clean = 0;
+    while (control != std::string_view::npos) {
+        // Copy the text in front of the code in one go, then skip the code
+        // and its parameters. All control characters are dropped.
+        storage.append(text.data() + clean, control - clean);
+        clean = control + 1 + parameterLength(text, control);
+        control = findControl(text, clean);
+    }
+    if (clean < text.length())
+        storage.append(text.data() + clean, text.length() - clean);
+    return storage;
+}
+
+void IRCFormatting::split(std::string_view text, size_t budget, std::vector<std::string_view> &lines) {
+    // The longest code is 0x04 RRGGBB,RRGGBB, longer texticons may be cut
+    static constexpr size_t longestCode = 14;
+    budget = std::max<size_t>(budget, 8);
+
+    while (text.length() > budget) {
+        size_t end = budget;
+        // Back off to the start of a UTF-8 sequence
+        while (end && (text[end] & 0xC0) == 0x80)
+            end--;
+        // and to the start of a code, when its parameters continue past end
+        for (size_t pos = end > longestCode ? end - longestCode : 0; pos < end; pos++) {
+            if ((unsigned char)text[pos] < 0x20 && pos + 1 + parameterLength(text, pos) > end) {
+                end = pos;
+                break;
+            }
+        }
+
+        size_t space = text.rfind(' ', end);
+        if (space != std::string_view::npos && space >= budget / 2) {
+            lines.push_back(text.substr(0, space));
+            text.remove_prefix(space + 1);
+            continue;
+        }
+        if (!end) {
+            // Only with a budget shorter than a code, cut it after all
+            end = budget;
+            while (end > 1 && (text[end] & 0xC0) == 0x80)
+                end--;
+        }
+        lines.push_back(text.substr(0, end));
+        text.remove_prefix(end);
+    }
+    if (text.length() || lines.empty())
+        lines.push_back(text);
+}
+
+std::vector<IRCFormatting::Span> IRCFormatting::parse(std::string_view text) {
+    std::vector<Span> spans;
+    uint8_t style = 0;
+    Colour foreground = noColour;
+    Colour background = noColour;
+
+    auto number = [&](size_t at, size_t digits) {
+        Colour colour = 0;
+        for (size_t i = 0; i < digits; i++)
+            colour = colour * 10 + (text[at + i] - '0');
+        // 99 is the default colour
+        return colour == 99 ? noColour : colour;
+    };
+    auto hex = [&](size_t at) {
+        Colour colour = 0;
+        for (size_t i = 0; i < 6; i++) {
+            char c = text[at + i];
+            colour = colour << 4 | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+        return rgbColour | colour;
+    };
+
+    size_t clean = 0;
+    size_t control = findControl(text);
+    while (clean < text.length()) {
+        size_t end = control == std::string_view::npos ? text.length() : control;
+        if (end > clean)
+            spans.push_back({uint32_t(clean), uint32_t(end - clean), foreground, background, style});
+        if (control == std::string_view::npos)
+            break;
+
+        size_t parameters = parameterLength(text, control);
+        std::string_view parameter = text.substr(control + 1, parameters);
+        switch ((unsigned char)text[control]) {
+        case bold:
+            style ^= styleBold;
+            break;
+        case italics:
+            style ^= styleItalics;
+            break;
+        case underline:
+            style ^= styleUnderline;
+            break;
+        case strikethrough:
+            style ^= styleStrikethrough;
+            break;
+        case monospace:
+            style ^= styleMonospace;
+            break;
+        case reversedcolor:
+            style ^= styleReverse;
+            break;
+        case reset:
+            style = 0;
+            foreground = background = noColour;
+            break;
+        case color:
+            if (parameter.empty()) {
+                foreground = background = noColour;
+            } else {
+                size_t comma = parameter.find(',');
+                size_t digits = comma == std::string_view::npos ? parameter.length() : comma;
+                foreground = number(control + 1, digits);
+                if (comma != std::string_view::npos)
+                    background = number(control + 2 + comma, parameter.length() - comma - 1);
+            }
+            break;
+        case hexcolor:
+            if (parameter.empty()) {
+                foreground = background = noColour;
+            } else {
+                foreground = hex(control + 1);
+                if (parameters > 6)
+                    background = hex(control + 8);
+            }
+            break;
+        default:
+            break;
+        }
+        clean = control + 1 + parameters;
+        control = findControl(text, clean);
+    }
+    return spans;
+}
+
+uint32_t IRCFormatting::paletteRGB(Colour colour) {
+    // https://modern.ircdocs.horse/formatting#colors
+    static constexpr std::array<uint32_t, 99> palette = {
+        0xffffff, 0x000000, 0x00007f, 0x009300, 0xff0000, 0x7f0000, 0x9c009c, 0xfc7f00, 0xffff00, 0x00fc00, 0x009393,
+        0x00ffff, 0x0000fc, 0xff00ff, 0x7f7f7f, 0xd2d2d2, 0x470000, 0x472100, 0x474700, 0x324700, 0x004700, 0x00472c,
+        0x004747, 0x002747, 0x000047, 0x2e0047, 0x470047, 0x47002a, 0x740000, 0x743a00, 0x747400, 0x517400, 0x007400,
+        0x007449, 0x007474, 0x004074, 0x000074, 0x4b0074, 0x740074, 0x740045, 0xb50000, 0xb56300, 0xb5b500, 0x7db500,
+        0x00b500, 0x00b571, 0x00b5b5, 0x0063b5, 0x0000b5, 0x7500b5, 0xb500b5, 0xb5006b, 0xff0000, 0xff8c00, 0xffff00,
+        0xb2ff00, 0x00ff00, 0x00ffa0, 0x00ffff, 0x008cff, 0x0000ff, 0xa500ff, 0xff00ff, 0xff0098, 0xff5959, 0xffb459,
+        0xffff71, 0xcfff60, 0x6fff6f, 0x65ffc9, 0x6dffff, 0x59b4ff, 0x5959ff, 0xc459ff, 0xff66ff, 0xff59bc, 0xff9c9c,
+        0xffd39c, 0xffff9c, 0xe2ff9c, 0x9cff9c, 0x9cffdb, 0x9cffff, 0x9cd3ff, 0x9c9cff, 0xdc9cff, 0xff9cff, 0xff94d3,
+        0x000000, 0x131313, 0x282828, 0x363636, 0x4d4d4d, 0x656565, 0x818181, 0x9f9f9f, 0xbcbcbc, 0xe2e2e2, 0xffffff,
+    };
+    if (colour & rgbColour)
+        return colour & 0xFFFFFF;
+    return palette[colour % palette.size()];
+}
+
+void IRCFormatting::renderANSI(std::string &out, std::string_view text, const std::vector<Span> &spans) {
+    out.reserve(out.length() + text.length() + spans.size() * 16);
+    // Select Graphic Rendition, with 24 bit colours
+    auto component = [&](uint8_t value) {
+        out += ';';
+        if (value >= 100)
+            out += char('0' + value / 100);
+        if (value >= 10)
+            out += char('0' + value / 10 % 10);
+        out += char('0' + value % 10);
+    };
+    auto colour = [&](const char *prefix, Colour colour) {
+        uint32_t rgb = paletteRGB(colour);
+        out += prefix;
+        out += ";2";
+        component(rgb >> 16);
+        component(rgb >> 8);
+        component(rgb);
+    };
+
+    const Span *previous = nullptr;
+    bool formatted = false;
+    for (auto &span : spans) {
+        bool plain = !span.style && span.foreground == noColour && span.background == noColour;
+        bool changed = previous ? (span.style != previous->style || span.foreground != previous->foreground ||
+                                   span.background != previous->background)
+                                : !plain;
+        if (changed) {
+            out += "\x1b[0";
+            if (span.style & styleBold)
+                out += ";1";
+            if (span.style & styleItalics)
+                out += ";3";
+            if (span.style & styleUnderline)
+                out += ";4";
+            if (span.style & styleReverse)
+                out += ";7";
+            if (span.style & styleStrikethrough)
+                out += ";9";
+            if (span.foreground != noColour)
+                colour(";38", span.foreground);
+            if (span.background != noColour)
+                colour(";48", span.background);
+            out += 'm';
+            formatted = !plain;
+        }
+        out.append(text.data() + span.offset, span.length);
+        previous = &span;
+    }
+    if (formatted)
+        out += "\x1b[0m";
+}
+
+void IRCFormatting::renderHTML(std::string &out, std::string_view text, const std::vector<Span> &spans) {
+    out.reserve(out.length() + text.length() + spans.size() * 32);
+    auto colour = [&](const char *property, Colour colour) {
+        static constexpr char digits[] = "0123456789abcdef";
+        uint32_t rgb = paletteRGB(colour);
+        out += property;
+        out += ":#";
+        for (int shift = 20; shift >= 0; shift -= 4)
+            out += digits[(rgb >> shift) & 0xF];
+        out += ';';
+    };
+
+    for (auto &span : spans) {
+        Colour foreground = span.foreground;
+        Colour background = span.background;
+        if (span.style & styleReverse)
+            std::swap(foreground, background);
+        bool styled = span.style & ~styleReverse || foreground != noColour || background != noColour;
+        if (styled) {
+            out += "<span style=\"";
+            if (span.style & styleBold)
+                out += "font-weight:bold;";
+            if (span.style & styleItalics)
+                out += "font-style:italic;";
+            if (span.style & (styleUnderline | styleStrikethrough)) {
+                out += "text-decoration:";
+                if (span.style & styleUnderline)
+                    out += " underline";
+                if (span.style & styleStrikethrough)
+                    out += " line-through";
+                out += ';';
+            }
+            if (span.style & styleMonospace)
+                out += "font-family:monospace;";
+            if (foreground != noColour)
+                colour("color", foreground);
+            if (background != noColour)
+                colour("background-color", background);
+            out += "\">";
+        }
+        for (char c : text.substr(span.offset, span.length)) {
+            switch (c) {
+            case '&':
+                out += "&amp;";
+                break;
+            case '<':
+                out += "&lt;";
+                break;
+            case '>':
+                out += "&gt;";
+                break;
+            case '"':
+                out += "&quot;";
+                break;
+            case '\'':
+                out += "&#39;";
+                break;
+            default:
+                out += c;
+            }
+        }
+        if (styled)
+            out += "</span>";
+    }
+}
+
+const std::vector<IRCFormatting::Span> &FormattedText::spans(void) {
+    if (!mSpans)
+        mSpans = IRCFormatting::parse(mText);
+    return *mSpans;
+}
+
+std::string_view FormattedText::plain(void) {
+    if (!mPlain)
+        mPlain = IRCFormatting::strip(mText, mPlainStorage);
+    return *mPlain;
+}
+
+const std::string &FormattedText::ansi(void) {
+    if (!mANSI) {
+        mANSI.emplace();
+        IRCFormatting::renderANSI(*mANSI, mText, spans());
+    }
+    return *mANSI;
+}
+
+const std::string &FormattedText::html(void) {
+    if (!mHTML) {
+        mHTML.emplace();
+        IRCFormatting::renderHTML(*mHTML, mText, spans());
+    }
+    return *mHTML;
+}
+
+} // namespace geblaat
@@ -0,0 +1,130 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef PROTOCOL_IRCFORMATTING_HPP_
+#define PROTOCOL_IRCFORMATTING_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace geblaat {
+
+// IRC formatting codes, https://modern.ircdocs.horse/formatting
+class IRCFormatting {
+  public:
+    enum Code : uint8_t {
+        bold = 0x02,
+        color = 0x03,
+        hexcolor = 0x04,
+        reset = 0x0f,
+        monospace = 0x11,
+        reversedcolor = 0x16,
+        texticon = 0x1c,
+        italics = 0x1d,
+        strikethrough = 0x1e,
+        underline = 0x1f,
+    };
+
+    // Position of the first byte below 0x20 at or after from, or npos.
+    // All formatting codes are in this range.
+    static size_t findControl(std::string_view text, size_t from = 0);
+
+    // Number of bytes following the code at pos that are its parameters
+    static size_t parameterLength(std::string_view text, size_t pos);
+
+    // Removes all formatting. Returns text itself when it contains no
+    // control characters, which is the case for most lines. Otherwise the
+    // result is built in storage.
+    static std::string_view strip(std::string_view text, std::string &storage);
+
+    // A colour is either an index in the 99 colour palette, or a hex colour
+    // as rgbColour | 0xRRGGBB
+    using Colour = uint32_t;
+    static constexpr Colour noColour = 0xFFFFFFFF;
+    static constexpr Colour rgbColour = 0x01000000;
+
+    enum Style : uint8_t {
+        styleBold = 0x01,
+        styleItalics = 0x02,
+        styleUnderline = 0x04,
+        styleStrikethrough = 0x08,
+        styleMonospace = 0x10,
+        styleReverse = 0x20,
+    };
+
+    // A run of text, in the formatted text, sharing the same formatting
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+        Colour foreground;
+        Colour background;
+        uint8_t style;
+    };
+
+    // Splits text into lines of at most budget bytes. Lines end at a space
+    // when there is one in the second half of the budget, the space itself
+    // is dropped. Code points and formatting codes with their parameters
+    // are never cut.
+    static void split(std::string_view text, size_t budget, std::vector<std::string_view> &lines);
+
+    static std::vector<Span> parse(std::string_view text);
+    static uint32_t paletteRGB(Colour colour);
+    static void renderANSI(std::string &out, std::string_view text, const std::vector<Span> &spans);
+    static void renderHTML(std::string &out, std::string_view text, const std::vector<Span> &spans);
+};
+
+// Formatted text with its renderings produced on first request. The spans
+// are only parsed when a rendering other than plain text is asked for.
+class FormattedText {
+  public:
+    explicit FormattedText(std::string text) : mText(std::move(text)) {}
+    // The plain text may refer into mText
+    FormattedText(const FormattedText &) = delete;
+    FormattedText &operator=(const FormattedText &) = delete;
+
+    const std::string &irc(void) const { return mText; }
+    const std::vector<IRCFormatting::Span> &spans(void);
+    std::string_view plain(void);
+    const std::string &ansi(void);
+    const std::string &html(void);
+
+  private:
+    std::string mText;
+    std::optional<std::vector<IRCFormatting::Span>> mSpans;
+    std::optional<std::string_view> mPlain;
+    std::string mPlainStorage;
+    std::optional<std::string> mANSI;
+    std::optional<std::string> mHTML;
+};
+
+} // namespace geblaat
+#endif /* PROTOCOL_IRCFORMATTING_HPP_ */
@@ -0,0 +1,203 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "IRCTags.hpp"
+
+#include <algorithm>
+
+namespace geblaat {
+
+/*
+ * https://ircv3.net/specs/extensions/message-tags
+ ; (semicolon)  \: (backslash and colon)
+ SPACE          \s
+ \              \\
+ CR             \r
+ LF             \n
+ */
+
+void IRCTags::encodeValue(std::string &out, std::string_view raw) {
+    for (char c : raw) {
+        switch (c) {
+        case ';':
+            out += "\\:";
+            break;
+        case ' ':
+            out += "\\s";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        default:
+            out += c;
+        }
+    }
+}
+
+template <typename String> void IRCTags::decodeValue(String &out, std::string_view escaped) {
+    /*
+    If a lone \ exists at the end of an escaped value (with no escape character
+    following it), then there SHOULD be no output character. For example, the
+    escaped value test\ should unescape to test. If a \ exists with no valid
+    escape character (for example, \b), then the invalid backslash SHOULD be
+    dropped. For example, \b should unescape to just b.
+     */
+    for (size_t i = 0; i < escaped.length(); i++) {
+        char c = escaped[i];
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (++i == escaped.length())
+            break;
+        switch (escaped[i]) {
+        case ':':
+            out += ';';
+            break;
+        case 's':
+            out += ' ';
+            break;
+        case 'r':
+            out += '\r';
+            break;
+        case 'n':
+            out += '\n';
+            break;
+        default:
+            out += escaped[i];
+        }
+    }
+}
+
+template void IRCTags::decodeValue(std::string &, std::string_view);
+template void IRCTags::decodeValue(std::pmr::string &, std::string_view);
+
+void IRCTags::clear(void) {
+    mStorage.clear();
+    mEntries.clear();
+    mHot.fill(-1);
+}
+
+void IRCTags::parse(std::string_view tagString) {
+    clear();
+    // The decoded string is never longer than the escaped one, reserving
+    // it up front means the storage is allocated once.
+    mStorage.reserve(tagString.length());
+
+    size_t pos = 0;
+    while (pos < tagString.length()) {
+        auto end = tagString.find(';', pos);
+        if (end == std::string_view::npos)
+            end = tagString.length();
+        auto tag = tagString.substr(pos, end - pos);
+        pos = end + 1;
+
+        auto equals = tag.find('=');
+        auto keyString = tag.substr(0, equals);
+        if (keyString.empty())
+            continue;
+
+        // If the tag has a vendor prefix, it might be punycode encoded
+        // We might want to decode it. However, how likely is it to
+        // encounter such a tag. Therefore this is low priority.
+        Entry entry;
+        entry.keyOffset = mStorage.length();
+        entry.keyLength = keyString.length();
+        mStorage += keyString;
+
+        entry.valueOffset = mStorage.length();
+        if (equals != std::string_view::npos)
+            decodeValue(mStorage, tag.substr(equals + 1));
+        entry.valueLength = mStorage.length() - entry.valueOffset;
+
+        insert(entry);
+    }
+
+    static constexpr std::string_view hotTags[hotTagCount] = {"account", "batch", "label", "msgid", "time"};
+    for (size_t i = 0; i < hotTagCount; i++)
+        mHot[i] = find(hotTags[i]);
+}
+
+void IRCTags::insert(Entry entry) {
+    // Insertion sort, a message carries a handful of tags
+    auto k = key(entry);
+    auto it = std::lower_bound(mEntries.begin(), mEntries.end(), k,
+                               [this](const Entry &e, std::string_view k) { return key(e) < k; });
+    if (it != mEntries.end() && key(*it) == k)
+        *it = entry;
+    else
+        mEntries.insert(it, entry);
+}
+
+int IRCTags::find(std::string_view k) const {
+    auto it = std::lower_bound(mEntries.begin(), mEntries.end(), k,
+                               [this](const Entry &e, std::string_view k) { return key(e) < k; });
+    if (it != mEntries.end() && key(*it) == k)
+        return it - mEntries.begin();
+    return -1;
+}
+
+std::string_view IRCTags::get(std::string_view k) const {
+    auto index = find(k);
+    if (index < 0)
+        return {};
+    return value(mEntries[index]);
+}
+
+std::string_view IRCTags::get(HotTag tag) const {
+    auto index = mHot[(size_t)tag];
+    if (index < 0)
+        return {};
+    return value(mEntries[index]);
+}
+
+IRCTags::Tag IRCTags::at(size_t index) const { return {key(mEntries[index]), value(mEntries[index])}; }
+
+void IRCTags::format(std::string &out, const std::map<std::string, std::string> &tags) {
+    bool first = true;
+    for (auto &tag : tags) {
+        if (!first)
+            out += ';';
+        first = false;
+        // A non-ascii key needs to be punycode encoded
+        // TODO: priority: low
+        out += tag.first;
+        if (tag.second.length()) {
+            out += '=';
+            encodeValue(out, tag.second);
+        }
+    }
+}
+
+} // namespace geblaat
@@ -0,0 +1,127 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef PROTOCOL_IRCTAGS_HPP_
+#define PROTOCOL_IRCTAGS_HPP_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace geblaat {
+
+// IRCv3 message tags, https://ircv3.net/specs/extensions/message-tags
+//
+// The decoded keys and values are stored back to back in a single string,
+// the entries referring to them are kept sorted by key. The tags servers
+// send on about every line can be looked up directly.
+// The storage is allocator aware, so it can be placed in a MessageArena.
+class IRCTags {
+  public:
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    enum class HotTag : uint8_t { account, batch, label, msgid, time };
+    static constexpr size_t hotTagCount = 5;
+
+    struct Tag {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    class Iterator {
+      public:
+        Iterator(const IRCTags *tags, size_t index) : mTags(tags), mIndex(index) {}
+        Tag operator*() const { return mTags->at(mIndex); }
+        Iterator &operator++() {
+            mIndex++;
+            return *this;
+        }
+        bool operator!=(const Iterator &other) const { return mIndex != other.mIndex; }
+
+      private:
+        const IRCTags *mTags;
+        size_t mIndex;
+    };
+
+    explicit IRCTags(const allocator_type &alloc = {}) : mStorage(alloc), mEntries(alloc) { mHot.fill(-1); }
+    IRCTags(const IRCTags &other, const allocator_type &alloc = {})
+        : mStorage(other.mStorage, alloc), mEntries(other.mEntries, alloc), mHot(other.mHot) {}
+    IRCTags(IRCTags &&other) = default;
+    IRCTags &operator=(const IRCTags &other) = default;
+    IRCTags &operator=(IRCTags &&other) = default;
+
+    // Decodes a tag string, without the leading '@', in a single pass.
+    // Values are unescaped. When a key occurs more than once, the last
+    // value is kept.
+    void parse(std::string_view tagString);
+    void clear(void);
+
+    bool contains(std::string_view key) const { return find(key) >= 0; }
+    bool contains(HotTag tag) const { return mHot[(size_t)tag] >= 0; }
+
+    // Returns the value of the tag, or an empty view if it is not present
+    std::string_view get(std::string_view key) const;
+    std::string_view get(HotTag tag) const;
+
+    size_t size(void) const { return mEntries.size(); }
+    bool empty(void) const { return mEntries.empty(); }
+    Tag at(size_t index) const;
+    Iterator begin(void) const { return Iterator(this, 0); }
+    Iterator end(void) const { return Iterator(this, mEntries.size()); }
+
+    // Appends the tags, escaped, to the output string, as sent after the
+    // '@' of an outgoing message.
+    static void format(std::string &out, const std::map<std::string, std::string> &tags);
+
+    static void encodeValue(std::string &out, std::string_view raw);
+    template <typename String> static void decodeValue(String &out, std::string_view escaped);
+
+  private:
+    struct Entry {
+        uint16_t keyOffset;
+        uint16_t keyLength;
+        uint16_t valueOffset;
+        uint16_t valueLength;
+    };
+
+    std::pmr::string mStorage;
+    std::pmr::vector<Entry> mEntries;
+    std::array<int16_t, hotTagCount> mHot;
+
+    std::string_view key(const Entry &entry) const { return {mStorage.data() + entry.keyOffset, entry.keyLength}; }
+    std::string_view value(const Entry &entry) const { return {mStorage.data() + entry.valueOffset, entry.valueLength}; }
+    int find(std::string_view key) const;
+    void insert(Entry entry);
+};
+
+} // namespace geblaat
+#endif /* PROTOCOL_IRCTAGS_HPP_ */
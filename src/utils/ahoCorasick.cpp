@@ -0,0 +1,121 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "ahoCorasick.hpp"
+
+#include <cctype>
+
+AhoCorasick::Pattern AhoCorasick::add(std::string_view pattern) {
+    mPatterns.emplace_back(pattern);
+    mBuilt = false;
+    return mPatterns.size() - 1;
+}
+
+void AhoCorasick::clear(void) {
+    mPatterns.clear();
+    mTransitions.clear();
+    mOutput.clear();
+    mNext.clear();
+    mClass = {};
+    mClasses = 1;
+    mBuilt = false;
+}
+
+void AhoCorasick::build(void) {
+    auto fold = [this](unsigned char c) -> unsigned char { return mCaseInsensitive ? tolower(c) : c; };
+
+    // Class 0 is for the bytes no pattern uses
+    mClass = {};
+    mClasses = 1;
+    for (auto &pattern : mPatterns) {
+        for (unsigned char c : pattern) {
+            c = fold(c);
+            if (!mClass[c])
+                mClass[c] = mClasses++;
+        }
+    }
+    if (mCaseInsensitive)
+        for (unsigned c = 'A'; c <= 'Z'; c++)
+            mClass[c] = mClass[c + ('a' - 'A')];
+
+    // The trie. As the root is never a child, 0 marks a missing transition.
+    mTransitions.assign(mClasses, 0);
+    mOutput.assign(1, none);
+    mNext.assign(mPatterns.size(), none);
+    for (Pattern p = 0; p < mPatterns.size(); p++) {
+        uint32_t state = 0;
+        for (unsigned char c : mPatterns[p]) {
+            uint32_t &next = mTransitions[state * mClasses + mClass[c]];
+            if (!next) {
+                next = mOutput.size();
+                mOutput.push_back(none);
+                mTransitions.resize(mTransitions.size() + mClasses, 0);
+            }
+            // The resize may have moved the table
+            state = mTransitions[state * mClasses + mClass[c]];
+        }
+        if (state) {
+            mNext[p] = mOutput[state];
+            mOutput[state] = p;
+        }
+    }
+
+    // Breadth first, so the failure state of every state is complete before
+    // the state itself. Missing transitions are taken from the failure state.
+    std::vector<uint32_t> failure(mOutput.size(), 0);
+    std::vector<uint32_t> queue;
+    queue.reserve(mOutput.size());
+    for (uint32_t c = 0; c < mClasses; c++)
+        if (mTransitions[c])
+            queue.push_back(mTransitions[c]);
+    for (size_t head = 0; head < queue.size(); head++) {
+        uint32_t state = queue[head];
+        uint32_t fail = failure[state];
+
+        // Append the patterns of the failure state to our own
+        if (mOutput[state] == none) {
+            mOutput[state] = mOutput[fail];
+        } else {
+            Pattern last = mOutput[state];
+            while (mNext[last] != none)
+                last = mNext[last];
+            mNext[last] = mOutput[fail];
+        }
+
+        for (uint32_t c = 0; c < mClasses; c++) {
+            uint32_t &next = mTransitions[state * mClasses + c];
+            if (next) {
+                failure[next] = mTransitions[fail * mClasses + c];
+                queue.push_back(next);
+            } else {
+                next = mTransitions[fail * mClasses + c];
+            }
+        }
+    }
+    mBuilt = true;
+}
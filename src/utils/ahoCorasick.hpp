@@ -0,0 +1,91 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_AHOCORASICK_HPP_
+#define UTILS_AHOCORASICK_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Finds all occurrences of a set of literal patterns in a single pass over
+// the text. The patterns are compiled into a deterministic automaton with
+// the failure links resolved, so scanning costs one table lookup per byte
+// no matter how many patterns there are. To keep the table small, bytes are
+// mapped to classes first: all bytes no pattern uses share one class, and
+// when matching case insensitive, so do upper and lower case ASCII letters.
+class AhoCorasick {
+  public:
+    using Pattern = uint32_t;
+    static constexpr Pattern none = UINT32_MAX;
+
+    explicit AhoCorasick(bool caseInsensitive = true) : mCaseInsensitive(caseInsensitive) {}
+
+    // Returns the number of the pattern. The automaton has to be built
+    // again before the pattern is found.
+    Pattern add(std::string_view pattern);
+    void build(void);
+    void clear(void);
+
+    size_t size(void) const { return mPatterns.size(); }
+    const std::string &pattern(Pattern pattern) const { return mPatterns[pattern]; }
+    bool built(void) const { return mBuilt; }
+
+    // Calls found(pattern, end) for every occurrence, end being the offset
+    // just past it. Scanning stops when found returns false.
+    template <typename Found> void scan(std::string_view text, Found found) const {
+        if (!mBuilt)
+            return;
+        uint32_t state = 0;
+        for (size_t i = 0; i < text.length(); i++) {
+            state = mTransitions[state * mClasses + mClass[(unsigned char)text[i]]];
+            for (Pattern pattern = mOutput[state]; pattern != none; pattern = mNext[pattern])
+                if (!found(pattern, i + 1))
+                    return;
+        }
+    }
+
+  private:
+    bool mCaseInsensitive;
+    bool mBuilt = false;
+    std::vector<std::string> mPatterns;
+
+    std::array<uint8_t, 256> mClass = {};
+    uint32_t mClasses = 1;
+    // mClasses transitions for every state, state 0 is the root
+    std::vector<uint32_t> mTransitions;
+    // The first pattern found on entering a state, the others are linked
+    // through mNext, ending with the patterns of its failure state
+    std::vector<Pattern> mOutput;
+    std::vector<Pattern> mNext;
+};
+
+#endif /* UTILS_AHOCORASICK_HPP_ */
@@ -0,0 +1,240 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "caseMapping.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "logger.hpp"
+
+void CaseMapping::configure(std::string_view caseMapping, bool utf8Mapping) {
+    /*
+     The value MUST be specified and is a string. Servers MAY advertise
+     alternate casemappings to those above, but clients MAY NOT be able to
+     understand or perform them. If the parameter is not published by the
+     server at all, clients SHOULD assume CASEMAPPING=rfc1459.
+     */
+    if (caseMapping.empty())
+        caseMapping = "rfc1459";
+
+    // See also
+    // https://github.com/DanielOaks/ircv3-specifications/blob/master+rfc7700/documentation/rfc8265.md
+    // suggesting
+
+    // CASEMAPPING=ascii UTF8MAPPING=rfc8265
+
+    // https://github.com/ircv3/ircv3-specifications/pull/272/commits/807e084fba9634084054def193424b9589f2a56b
+    // https://github.com/DanielOaks/ircv3-specifications/blob/master%2Brfc7700/documentation/rfc8265.md
+
+    // Changed casemapping from "rfc7700" to "rfc7613", to match new draft spec.
+    // The recommended value of `server.casemapping` is now `ascii` instead of
+    // `precis`.
+
+    // Many possible values for utf8 mapping, for now, we only have one
+    // casemapping case for utf8
+    mUtf8 = utf8Mapping;
+
+    // As some point, it was decided, when UTF8 case mapping is in use, rather
+    // then putting some RFC in the casemapping, put ascii and create a new
+    // UTF8MAPPING feature. However, older specs mention some values in
+    // casemapping to indicate UTF8 mapping
+    // *  rfc7613 mentioned in https://modern.ircdocs.horse/
+    // *  rfc3454 mentioned in https://defs.ircdocs.horse/defs/isupport
+    // If we encounter such, we use the, to my knowledge, latest approach:
+    // First apply ASCII mapping, then apply UTF mapping.
+    if ((caseMapping == "rfc3454") || (caseMapping == "rfc7700") || (caseMapping == "rfc7613") || (caseMapping == "rfc8265") ||
+        (caseMapping == "precis") || (caseMapping == "utf8")) {
+        caseMapping = "ascii";
+        mUtf8 = true;
+    }
+
+    if (caseMapping == "ascii") {
+        // https://datatracker.ietf.org/doc/html/draft-hardy-irc-isupport-00#section-4.1
+        // "ascii": The ASCII characters 97 to 122 (decimal) are defined as
+        // the lower-case characters of ASCII 65 to 90 (decimal).  No other
+        // character equivalency is defined.
+        mType = Type::ascii;
+        mTable = &asciiTable;
+        mLastUpper = 'Z';
+    } else if (caseMapping == "rfc1459") {
+        // https://datatracker.ietf.org/doc/html/draft-hardy-irc-isupport-00#section-4.1
+        // "rfc1459": The ASCII characters 97 to 126 (decimal) are defined as
+        // the lower-case characters of ASCII 65 to 94 (decimal).  No other
+        // character equivalency is defined.
+        mType = Type::rfc1459;
+        mTable = &rfc1459Table;
+        mLastUpper = '^';
+    } else if (caseMapping == "rfc1459-strict" || caseMapping == "strict-rfc1459") {
+        // https://datatracker.ietf.org/doc/html/draft-hardy-irc-isupport-00#section-4.1
+        // "strict-rfc1459": The ASCII characters 97 to 125 (decimal) are
+        // defined as the lower-case characters of ASCII 65 to 93 (decimal).
+        // no other character equivalency is defined.
+        mType = Type::rfc1459Strict;
+        mTable = &rfc1459StrictTable;
+        mLastUpper = ']';
+    } else {
+        // Unknown case mapping? What should we do in this case?
+        // Safe to assume at least ASCII should map?
+        LOG_WARNING("Unknown case mapping %.*s, using ascii", (int)caseMapping.length(), caseMapping.data());
+        mType = Type::ascii;
+        mTable = &asciiTable;
+        mLastUpper = 'Z';
+    }
+}
+
+// All upper case characters of the mappings lie in 'A' (0x41) to '^' (0x5E),
+// which have the 0x20 bit clear: folding sets it. Bytes of 0x80 and above
+// compare as negative, so they are outside the range.
+#if defined(__AVX2__)
+static inline __m256i fold32(__m256i block, __m256i below, __m256i above) {
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(block, below), _mm256_cmpgt_epi8(above, block));
+    return _mm256_or_si256(block, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+static inline __m128i fold16(__m128i block, __m128i below, __m128i above) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, below), _mm_cmplt_epi8(block, above));
+    return _mm_or_si128(block, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+bool CaseMapping::equals(std::string_view first, std::string_view second) const {
+    if (first.length() != second.length())
+        return false;
+    const char *a = first.data();
+    const char *b = second.data();
+    size_t length = first.length();
+
+#if defined(__AVX2__)
+    const __m256i below32 = _mm256_set1_epi8('A' - 1);
+    const __m256i above32 = _mm256_set1_epi8(mLastUpper + 1);
+    while (length >= 32) {
+        __m256i blockA = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a)), below32, above32);
+        __m256i blockB = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b)), below32, above32);
+        if (unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(blockA, blockB))) != 0xFFFFFFFF)
+            return false;
+        a += 32;
+        b += 32;
+        length -= 32;
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i below16 = _mm_set1_epi8('A' - 1);
+    const __m128i above16 = _mm_set1_epi8(mLastUpper + 1);
+    while (length) {
+        __m128i blockA, blockB;
+        if (length >= 16) {
+            blockA = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+            blockB = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+        } else {
+            // Nicks are mostly shorter than a block
+            alignas(16) char paddedA[16] = {}, paddedB[16] = {};
+            memcpy(paddedA, a, length);
+            memcpy(paddedB, b, length);
+            blockA = _mm_load_si128(reinterpret_cast<const __m128i *>(paddedA));
+            blockB = _mm_load_si128(reinterpret_cast<const __m128i *>(paddedB));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(fold16(blockA, below16, above16), fold16(blockB, below16, above16))) != 0xFFFF)
+            return false;
+        size_t done = std::min<size_t>(length, 16);
+        a += done;
+        b += done;
+        length -= done;
+    }
+    return true;
+#else
+    for (size_t i = 0; i < length; i++) {
+        if ((*mTable)[(unsigned char)a[i]] != (*mTable)[(unsigned char)b[i]])
+            return false;
+    }
+    return true;
+#endif
+}
+
+bool CaseMapping::isAscii(std::string_view str) {
+    const char *data = str.data();
+    size_t length = str.length();
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; length >= 16; data += 16, length -= 16) {
+        if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data))))
+            return false;
+    }
+#endif
+    for (; length; data++, length--) {
+        if ((unsigned char)*data & 0x80)
+            return false;
+    }
+    return true;
+}
+
+void CaseMapping::foldBlock(const char *data, size_t length, char *block) const {
+#if defined(__AVX2__) || defined(__SSE2__)
+    __m128i input;
+    if (length >= 16) {
+        input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    } else {
+        alignas(16) char padded[16] = {};
+        memcpy(padded, data, length);
+        input = _mm_load_si128(reinterpret_cast<const __m128i *>(padded));
+    }
+    input = fold16(input, _mm_set1_epi8('A' - 1), _mm_set1_epi8(mLastUpper + 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(block), input);
+#else
+    size_t i = 0;
+    for (; i < length && i < 16; i++)
+        block[i] = (*mTable)[(unsigned char)data[i]];
+    for (; i < 16; i++)
+        block[i] = 0;
+#endif
+}
+
+size_t CaseMapping::hash(std::string_view str) const {
+    // Mixes the folded string eight bytes at a time
+    auto mix = [](uint64_t h) {
+        h *= 0xff51afd7ed558ccdull;
+        return h ^ (h >> 32);
+    };
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ str.length();
+    char block[16];
+    for (size_t i = 0; i < str.length(); i += 16) {
+        foldBlock(str.data() + i, str.length() - i, block);
+        uint64_t low, high;
+        memcpy(&low, block, 8);
+        memcpy(&high, block + 8, 8);
+        h = mix(h ^ low);
+        h = mix(h ^ high);
+    }
+    return size_t(h);
+}
@@ -0,0 +1,135 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_CASEMAPPING_HPP_
+#define UTILS_CASEMAPPING_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// IRC casemapping, as advertised by the CASEMAPPING and UTF8MAPPING ISUPPORT
+// tokens. The advertised values are compiled once, by configure(), into a
+// byte fold table and a flag telling whether a UTF-8 mapping applies on top
+// of it. Folding then is a table lookup per byte.
+namespace caseMappingDetail {
+using Table = std::array<unsigned char, 256>;
+
+// Folds 'A' up to and including lastUpper to lower case
+constexpr Table makeTable(unsigned char lastUpper) {
+    Table table = {};
+    for (unsigned i = 0; i < table.size(); i++)
+        table[i] = (i >= 'A' && i <= lastUpper) ? i + ('a' - 'A') : i;
+    return table;
+}
+} // namespace caseMappingDetail
+
+class CaseMapping {
+  public:
+    enum class Type {
+        ascii,
+        rfc1459,
+        rfc1459Strict,
+    };
+
+    using Table = caseMappingDetail::Table;
+
+    // ascii:          A-Z             to a-z
+    // rfc1459:        A-Z [ \ ] ^     to a-z { | } ~
+    // rfc1459-strict: A-Z [ \ ]       to a-z { | }
+    static constexpr Table asciiTable = caseMappingDetail::makeTable('Z');
+    static constexpr Table rfc1459Table = caseMappingDetail::makeTable('^');
+    static constexpr Table rfc1459StrictTable = caseMappingDetail::makeTable(']');
+
+    // Compiles the advertised values. Without CASEMAPPING, rfc1459 is assumed.
+    void configure(std::string_view caseMapping, bool utf8Mapping);
+
+    // Compares and hashes with the byte fold applied on the fly, using SSE2
+    // or AVX2 when available for the target. The UTF-8 mapping is not
+    // applied: on networks with utf8() set, fold the strings with it first.
+    bool equals(std::string_view first, std::string_view second) const;
+    size_t hash(std::string_view str) const;
+
+    // The UTF-8 mapping leaves ASCII untouched, so the byte fold is all
+    // such strings need
+    static bool isAscii(std::string_view str);
+
+    // Transparent hasher and comparator for unordered containers keyed by
+    // nick or channel name: lookups take any string_view and never
+    // materialise a folded key. They refer to the CaseMapping, so its
+    // containers have to be rehashed when it is reconfigured to another type.
+    struct Hash {
+        using is_transparent = void;
+        const CaseMapping *mapping;
+        size_t operator()(std::string_view str) const { return mapping->hash(str); }
+    };
+    struct Equal {
+        using is_transparent = void;
+        const CaseMapping *mapping;
+        bool operator()(std::string_view first, std::string_view second) const { return mapping->equals(first, second); }
+    };
+    Hash hasher(void) const { return {this}; }
+    Equal comparator(void) const { return {this}; }
+
+    Type type(void) const { return mType; }
+    bool utf8(void) const { return mUtf8; }
+    const Table &table(void) const { return *mTable; }
+
+    char fold(char c) const { return (*mTable)[(unsigned char)c]; }
+
+    // Folds in place
+    void fold(char *data, size_t length) const {
+        for (size_t i = 0; i < length; i++)
+            data[i] = (*mTable)[(unsigned char)data[i]];
+    }
+    void fold(std::string &str) const { fold(str.data(), str.length()); }
+
+    // Folds into the caller's buffer, which holds at least str.length() bytes
+    void fold(std::string_view str, char *buffer) const {
+        for (size_t i = 0; i < str.length(); i++)
+            buffer[i] = (*mTable)[(unsigned char)str[i]];
+    }
+    // Folds into the caller's string, reusing its capacity
+    void fold(std::string_view str, std::string &result) const {
+        result.resize(str.length());
+        fold(str, result.data());
+    }
+
+  private:
+    Type mType = Type::rfc1459;
+    bool mUtf8 = false;
+    const Table *mTable = &rfc1459Table;
+    unsigned char mLastUpper = '^';
+
+    // Folds up to 16 bytes into block, padding it with zeroes
+    void foldBlock(const char *data, size_t length, char *block) const;
+};
+
+#endif /* UTILS_CASEMAPPING_HPP_ */
@@ -0,0 +1,146 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "lineBuffer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "logger.hpp"
+
+const char *findLineFeed(const char *data, size_t length) {
+#if defined(__AVX2__)
+    const __m256i lf32 = _mm256_set1_epi8('\n');
+    while (length >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lf32));
+        if (mask)
+            return data + std::countr_zero(mask);
+        data += 32;
+        length -= 32;
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i lf16 = _mm_set1_epi8('\n');
+    while (length >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, lf16));
+        if (mask)
+            return data + std::countr_zero(mask);
+        data += 16;
+        length -= 16;
+    }
+#endif
+    if (!length)
+        return nullptr;
+    return static_cast<const char *>(memchr(data, '\n', length));
+}
+
+LineBuffer::LineBuffer(size_t capacity) : mBuffer(capacity) {}
+
+void LineBuffer::clear(void) {
+    mBegin = mEnd = mScan = 0;
+    mDiscarding = false;
+}
+
+size_t LineBuffer::append(const char *data, size_t length) {
+    if (mEnd == mBuffer.size()) {
+        if (mBegin) {
+            // Move the pending partial line to the front
+            memmove(mBuffer.data(), mBuffer.data() + mBegin, mEnd - mBegin);
+            mScan -= mBegin;
+            mEnd -= mBegin;
+            mBegin = 0;
+        } else {
+            // The buffer is full and contains no line feed: this line
+            // exceeds the capacity. Drop it, including whatever of it
+            // is still to arrive.
+            if (!mDiscarding) {
+                LOG_WARNING("Dropping line exceeding %d bytes", (int)mBuffer.size());
+                mOverflows++;
+            }
+            mBegin = mEnd = mScan = 0;
+            mDiscarding = true;
+        }
+    } else if (mBegin && length > mBuffer.size() - mEnd) {
+        memmove(mBuffer.data(), mBuffer.data() + mBegin, mEnd - mBegin);
+        mScan -= mBegin;
+        mEnd -= mBegin;
+        mBegin = 0;
+    }
+
+    size_t taken = std::min(length, mBuffer.size() - mEnd);
+    memcpy(mBuffer.data() + mEnd, data, taken);
+    mEnd += taken;
+    return taken;
+}
+
+bool LineBuffer::nextLine(std::string_view &line) {
+    while (mScan < mEnd) {
+        const char *lf = findLineFeed(mBuffer.data() + mScan, mEnd - mScan);
+        if (!lf) {
+            // No complete line, the next scan continues from here
+            mScan = mEnd;
+            return false;
+        }
+
+        size_t start = mBegin;
+        size_t lineEnd = lf - mBuffer.data();
+        mBegin = mScan = lineEnd + 1;
+
+        if (mDiscarding) {
+            // Remainder of a line that was too long
+            mDiscarding = false;
+            continue;
+        }
+
+        // Strip the CR of a CR-LF pair, servers may send bare LF
+        if (lineEnd > start && mBuffer[lineEnd - 1] == '\r')
+            lineEnd--;
+
+        // Empty messages are to be silently ignored
+        if (lineEnd == start)
+            continue;
+
+        line = std::string_view(mBuffer.data() + start, lineEnd - start);
+        return true;
+    }
+
+    if (mBegin == mEnd) {
+        // Everything consumed, start at the front again
+        mBegin = mEnd = mScan = 0;
+    }
+    return false;
+}
@@ -0,0 +1,77 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_LINEBUFFER_HPP_
+#define UTILS_LINEBUFFER_HPP_
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Frames a byte stream into lines. The buffer has a fixed capacity and is
+// compacted only when the incoming data does not fit behind the pending
+// data, so consuming a line never moves the remaining data.
+//
+// Lines may be terminated by either CR-LF or a bare LF. The returned lines
+// do not contain the line terminator, and point into the buffer: they are
+// valid until the next call to append().
+class LineBuffer {
+  public:
+    // IRCv3: clients must allow 8191 bytes of tags in addition to the
+    // 512 bytes of the message itself.
+    static constexpr size_t defaultCapacity = 8191 + 512;
+
+    explicit LineBuffer(size_t capacity = defaultCapacity);
+
+    // Copies as much of the data as fits into the buffer and returns the
+    // number of bytes taken. Call nextLine() until it returns false before
+    // appending the remainder.
+    size_t append(const char *data, size_t length);
+
+    // Obtains the next complete line. Empty lines are skipped.
+    bool nextLine(std::string_view &line);
+
+    void clear(void);
+
+    // Number of lines dropped for exceeding the capacity
+    size_t overflows(void) const { return mOverflows; }
+
+  private:
+    std::vector<char> mBuffer;
+    size_t mBegin = 0; // Start of the data not yet returned as a line
+    size_t mEnd = 0;   // End of the valid data
+    size_t mScan = 0;  // Where the search for the next line feed resumes
+    bool mDiscarding = false;
+    size_t mOverflows = 0;
+};
+
+// Returns a pointer to the first line feed in the given range, or nullptr.
+// Uses SSE2 or AVX2 when available for the target.
+const char *findLineFeed(const char *data, size_t length);
+
+#endif /* UTILS_LINEBUFFER_HPP_ */
@@ -0,0 +1,66 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "lruCache.hpp"
+
+const std::string *LRUCache::find(std::string_view key) {
+    auto it = mIndex.find(key);
+    if (it == mIndex.end()) {
+        mMisses++;
+        return nullptr;
+    }
+    mHits++;
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return &it->second->second;
+}
+
+void LRUCache::insert(std::string_view key, std::string value) {
+    if (!mCapacity)
+        return;
+    auto it = mIndex.find(key);
+    if (it != mIndex.end()) {
+        it->second->second = std::move(value);
+        mEntries.splice(mEntries.begin(), mEntries, it->second);
+        return;
+    }
+    if (mEntries.size() >= mCapacity) {
+        // Reuse the node of the least recently used entry
+        mIndex.erase(mEntries.back().first);
+        mEntries.splice(mEntries.begin(), mEntries, std::prev(mEntries.end()));
+        mEntries.front().first = key;
+        mEntries.front().second = std::move(value);
+    } else {
+        mEntries.emplace_front(std::string(key), std::move(value));
+    }
+    mIndex.emplace(mEntries.front().first, mEntries.begin());
+}
+
+void LRUCache::clear(void) {
+    mIndex.clear();
+    mEntries.clear();
+}
@@ -0,0 +1,70 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_LRUCACHE_HPP_
+#define UTILS_LRUCACHE_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// Bounded cache mapping strings to strings. When it is full, the least
+// recently used entry makes room for the new one. Lookups take a
+// string_view and do not allocate.
+class LRUCache {
+  public:
+    static constexpr size_t defaultCapacity = 4096;
+
+    explicit LRUCache(size_t capacity = defaultCapacity) : mCapacity(capacity) {}
+
+    // Returns the cached value, or nullptr when the key is not cached. The
+    // pointer is valid until the next insert() or clear().
+    const std::string *find(std::string_view key);
+    void insert(std::string_view key, std::string value);
+    void clear(void);
+
+    size_t size(void) const { return mEntries.size(); }
+    size_t capacity(void) const { return mCapacity; }
+    size_t hits(void) const { return mHits; }
+    size_t misses(void) const { return mMisses; }
+
+  private:
+    // Most recently used first. The index refers to the keys stored here,
+    // list nodes do not move.
+    std::list<std::pair<std::string, std::string>> mEntries;
+    std::unordered_map<std::string_view, decltype(mEntries)::iterator> mIndex;
+    size_t mCapacity;
+    size_t mHits = 0;
+    size_t mMisses = 0;
+};
+
+#endif /* UTILS_LRUCACHE_HPP_ */
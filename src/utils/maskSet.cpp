@@ -0,0 +1,455 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "maskSet.hpp"
+
+#include <algorithm>
+
+MaskSet::MaskSet(const CaseMapping &caseMapping) : mCaseMapping(caseMapping) { mEntries.emplace_back(); }
+
+std::string MaskSet::complete(std::string_view mask) {
+    std::string result;
+    auto bang = mask.find('!');
+    auto at = mask.find('@');
+    if (bang != std::string_view::npos && at != std::string_view::npos && bang < at) {
+        result = mask;
+    } else if (at != std::string_view::npos) {
+        result = "*!";
+        result += mask;
+    } else if (bang != std::string_view::npos) {
+        result = mask;
+        result += "@*";
+    } else if (mask.find_first_of(".:") != std::string_view::npos) {
+        result = "*!*@";
+        result += mask;
+    } else {
+        result = mask;
+        result += "!*@*";
+    }
+    return result;
+}
+
+bool MaskSet::makeKey(std::string_view mask, Entry &entry) const {
+    if (mask.empty())
+        return false;
+
+    std::string_view account;
+    bool extban = false;
+    if (mask == "$a") {
+        entry.kind = Kind::anyAccount;
+        entry.key = "$a";
+        extban = true;
+    } else if (mask == "$~a") {
+        entry.kind = Kind::noAccount;
+        entry.key = "$~a";
+        extban = true;
+    } else {
+        for (std::string_view prefix : {"$a:", "~a:", "~account:"}) {
+            if (mask.starts_with(prefix)) {
+                account = mask.substr(prefix.length());
+                if (account.empty())
+                    return false;
+                extban = true;
+                break;
+            }
+        }
+        // Some other extban, such as "$r:realname" or "~c:#channel", depends
+        // on information we do not have. A '~' may as well start the user of
+        // a "~user@host" mask though.
+        if (!extban && mask[0] == '$')
+            return false;
+        if (!extban && mask[0] == '~') {
+            auto colon = mask.find(':');
+            if (colon != std::string_view::npos && colon < mask.find_first_of("!@."))
+                return false;
+        }
+    }
+
+    if (account.length()) {
+        entry.kind = account.find_first_of("*?") == std::string_view::npos ? Kind::accountExact : Kind::accountGlob;
+        entry.key = "$a:";
+        entry.key += account;
+        mCaseMapping.fold(entry.key.data() + 3, account.length());
+        entry.mask = "$a:";
+        entry.mask += account;
+        return true;
+    }
+    if (extban) {
+        entry.mask = entry.key;
+        return true;
+    }
+
+    entry.mask = complete(mask);
+    mCaseMapping.fold(entry.mask, entry.key);
+    // Runs of stars match the same as a single one
+    entry.key.erase(std::unique(entry.key.begin(), entry.key.end(), [](char a, char b) { return a == '*' && b == '*'; }),
+                    entry.key.end());
+    // index() looks for a fragment to index a residue mask on
+    entry.kind = entry.key.find_first_of("*?") == std::string::npos ? Kind::exact : Kind::residue;
+    return true;
+}
+
+void MaskSet::eraseFrom(std::vector<Id> &ids, Id id) {
+    auto it = std::find(ids.begin(), ids.end(), id);
+    if (it != ids.end()) {
+        *it = ids.back();
+        ids.pop_back();
+    }
+}
+
+std::array<std::string_view, 3> MaskSet::fields(std::string_view source) {
+    auto bang = std::min(source.find('!'), source.length());
+    auto at = std::min(source.find('@', bang), source.length());
+    return {source.substr(0, bang), source.substr(std::min(bang + 1, at), at - std::min(bang + 1, at)),
+            source.substr(std::min(at + 1, source.length()))};
+}
+
+std::string_view MaskSet::fragment(const Entry &entry) {
+    auto field = fields(entry.key)[entry.anchor / 2];
+    return entry.anchor % 2 ? field.substr(field.length() - entry.fragment) : field.substr(0, entry.fragment);
+}
+
+void MaskSet::index(Id id) {
+    auto &entry = mEntries[id];
+    if (entry.kind == Kind::residue) {
+        // Take the longest fragment anchored in a field
+        auto split = fields(entry.key);
+        for (unsigned anchor = 0; anchor < anchors; anchor++) {
+            auto field = split[anchor / 2];
+            size_t length;
+            if (anchor % 2)
+                length = field.length() - std::min(field.find_last_of("*?") + 1, field.length());
+            else
+                length = std::min(field.find_first_of("*?"), field.length());
+            if (length > entry.fragment) {
+                entry.fragment = length;
+                entry.anchor = Anchor(anchor);
+            }
+        }
+        if (entry.fragment >= 3)
+            entry.kind = Kind::fragment;
+
+        // Otherwise the trigram with the smallest bucket, so a popular one
+        // such as "com" does not collect all masks
+        std::string_view key = entry.key;
+        size_t best = SIZE_MAX;
+        size_t run = 0;
+        for (size_t i = 0; i < key.length() && entry.kind == Kind::residue; i++) {
+            if (key[i] == '*' || key[i] == '?') {
+                run = 0;
+                continue;
+            }
+            if (++run < 3)
+                continue;
+            uint32_t candidate = trigram(key.data() + i - 2);
+            auto bucket = mTrigrams.find(candidate);
+            size_t size = bucket == mTrigrams.end() ? 0 : bucket->second.size();
+            if (size < best) {
+                best = size;
+                entry.fragment = candidate;
+                if (!size)
+                    break;
+            }
+        }
+        if (best != SIZE_MAX)
+            entry.kind = Kind::trigram;
+        else if (entry.kind == Kind::residue && entry.fragment)
+            entry.kind = Kind::fragment;
+    }
+
+    switch (entry.kind) {
+    case Kind::exact:
+        mExact.emplace(entry.key, id);
+        break;
+    case Kind::fragment: {
+        auto fragment = MaskSet::fragment(entry);
+        auto &fragments = mFragments[entry.anchor];
+        auto bucket = fragments.find(fragment);
+        if (bucket == fragments.end())
+            bucket = fragments.emplace(fragment, std::vector<Id>()).first;
+        bucket->second.push_back(id);
+        auto &lengths = mFragmentLengths[entry.anchor];
+        if (lengths.size() <= fragment.length())
+            lengths.resize(fragment.length() + 1);
+        lengths[fragment.length()]++;
+        break;
+    }
+    case Kind::trigram:
+        mTrigrams[entry.fragment].push_back(id);
+        mTrigramPresent.set(trigramBit(entry.fragment));
+        break;
+    case Kind::residue:
+        mResidue.push_back(id);
+        break;
+    case Kind::accountExact:
+        mAccountExact.emplace(pattern(entry), id);
+        break;
+    case Kind::accountGlob:
+        mAccountGlobs.push_back(id);
+        break;
+    case Kind::anyAccount:
+        mAnyAccount.push_back(id);
+        break;
+    case Kind::noAccount:
+        mNoAccount.push_back(id);
+        break;
+    case Kind::unused:
+        break;
+    }
+}
+
+void MaskSet::unindex(Id id) {
+    auto &entry = mEntries[id];
+    switch (entry.kind) {
+    case Kind::exact:
+        mExact.erase(entry.key);
+        break;
+    case Kind::fragment: {
+        auto fragment = MaskSet::fragment(entry);
+        auto &fragments = mFragments[entry.anchor];
+        auto bucket = fragments.find(fragment);
+        if (bucket != fragments.end()) {
+            eraseFrom(bucket->second, id);
+            if (bucket->second.empty())
+                fragments.erase(bucket);
+            mFragmentLengths[entry.anchor][fragment.length()]--;
+        }
+        break;
+    }
+    case Kind::trigram: {
+        auto bucket = mTrigrams.find(entry.fragment);
+        if (bucket != mTrigrams.end()) {
+            eraseFrom(bucket->second, id);
+            // The bit stays set, it only costs a lookup until the next rebuild
+            if (bucket->second.empty())
+                mTrigrams.erase(bucket);
+        }
+        break;
+    }
+    case Kind::residue:
+        eraseFrom(mResidue, id);
+        break;
+    case Kind::accountExact:
+        mAccountExact.erase(pattern(entry));
+        break;
+    case Kind::accountGlob:
+        eraseFrom(mAccountGlobs, id);
+        break;
+    case Kind::anyAccount:
+        eraseFrom(mAnyAccount, id);
+        break;
+    case Kind::noAccount:
+        eraseFrom(mNoAccount, id);
+        break;
+    case Kind::unused:
+        break;
+    }
+}
+
+MaskSet::Id MaskSet::add(std::string_view mask) {
+    Entry entry;
+    if (!makeKey(mask, entry))
+        return none;
+
+    auto existing = mMasks.find(entry.key);
+    if (existing != mMasks.end())
+        return existing->second;
+
+    Id id;
+    if (mFree.size()) {
+        id = mFree.back();
+        mFree.pop_back();
+        mEntries[id] = std::move(entry);
+    } else {
+        id = mEntries.size();
+        mEntries.push_back(std::move(entry));
+    }
+    mMasks.emplace(mEntries[id].key, id);
+    index(id);
+    return id;
+}
+
+bool MaskSet::remove(std::string_view mask) {
+    Entry entry;
+    if (!makeKey(mask, entry))
+        return false;
+
+    auto existing = mMasks.find(entry.key);
+    if (existing == mMasks.end())
+        return false;
+
+    Id id = existing->second;
+    mMasks.erase(existing);
+    unindex(id);
+    mEntries[id] = Entry();
+    mFree.push_back(id);
+    return true;
+}
+
+void MaskSet::clear(void) {
+    mEntries.resize(1);
+    mFree.clear();
+    mMasks.clear();
+    mExact.clear();
+    for (auto &fragments : mFragments)
+        fragments.clear();
+    for (auto &lengths : mFragmentLengths)
+        lengths.clear();
+    mTrigrams.clear();
+    mTrigramPresent.reset();
+    mResidue.clear();
+    mAccountExact.clear();
+    mAccountGlobs.clear();
+    mAnyAccount.clear();
+    mNoAccount.clear();
+    mSeen.clear();
+}
+
+void MaskSet::rebuild(void) {
+    std::vector<std::string> masks;
+    masks.reserve(size());
+    for (auto &entry : mEntries)
+        if (entry.kind != Kind::unused)
+            masks.push_back(std::move(entry.mask));
+    clear();
+    for (auto &mask : masks)
+        add(mask);
+}
+
+bool MaskSet::glob(std::string_view mask, std::string_view str) {
+    // Backtracks to the last star only, which is enough as a star matches
+    // any run of bytes
+    size_t m = 0, s = 0;
+    size_t star = std::string_view::npos, resume = 0;
+    while (s < str.length()) {
+        if (m < mask.length() && (mask[m] == '?' || mask[m] == str[s])) {
+            m++;
+            s++;
+        } else if (m < mask.length() && mask[m] == '*') {
+            star = m++;
+            resume = s;
+        } else if (star != std::string_view::npos) {
+            m = star + 1;
+            s = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (m < mask.length() && mask[m] == '*')
+        m++;
+    return m == mask.length();
+}
+
+bool MaskSet::verify(Id id, std::string_view source) const {
+    if (mSeen[id] == mGeneration)
+        return false;
+    mSeen[id] = mGeneration;
+    return glob(mEntries[id].key, source);
+}
+
+void MaskSet::match(const Subject &subject, std::vector<Id> &matches) const {
+    if (mSeen.size() < mEntries.size())
+        mSeen.resize(mEntries.size());
+    if (!++mGeneration) {
+        std::fill(mSeen.begin(), mSeen.end(), 0);
+        mGeneration = 1;
+    }
+
+    mSource.clear();
+    mSource.reserve(subject.nick.length() + subject.user.length() + subject.host.length() + 2);
+    mSource += subject.nick;
+    mSource += '!';
+    mSource += subject.user;
+    mSource += '@';
+    mSource += subject.host;
+    mCaseMapping.fold(mSource);
+    std::string_view source = mSource;
+
+    auto exact = mExact.find(source);
+    if (exact != mExact.end())
+        matches.push_back(exact->second);
+
+    std::string_view split[] = {source.substr(0, subject.nick.length()),
+                                source.substr(subject.nick.length() + 1, subject.user.length()),
+                                source.substr(subject.nick.length() + subject.user.length() + 2)};
+    for (unsigned anchor = 0; anchor < anchors; anchor++) {
+        auto &fragments = mFragments[anchor];
+        auto &lengths = mFragmentLengths[anchor];
+        auto field = split[anchor / 2];
+        size_t longest = std::min(lengths.size(), field.length() + 1);
+        for (size_t length = 1; length < longest; length++) {
+            if (!lengths[length])
+                continue;
+            auto bucket = fragments.find(anchor % 2 ? field.substr(field.length() - length) : field.substr(0, length));
+            if (bucket == fragments.end())
+                continue;
+            for (Id id : bucket->second)
+                if (verify(id, source))
+                    matches.push_back(id);
+        }
+    }
+    if (mTrigrams.size()) {
+        for (size_t i = 2; i < source.length(); i++) {
+            uint32_t key = trigram(source.data() + i - 2);
+            if (!mTrigramPresent.test(trigramBit(key)))
+                continue;
+            auto bucket = mTrigrams.find(key);
+            if (bucket == mTrigrams.end())
+                continue;
+            for (Id id : bucket->second)
+                if (verify(id, source))
+                    matches.push_back(id);
+        }
+    }
+    for (Id id : mResidue)
+        if (verify(id, source))
+            matches.push_back(id);
+
+    if (subject.account.length()) {
+        matches.insert(matches.end(), mAnyAccount.begin(), mAnyAccount.end());
+        if (mAccountExact.size() || mAccountGlobs.size()) {
+            mCaseMapping.fold(subject.account, mAccount);
+            auto account = mAccountExact.find(mAccount);
+            if (account != mAccountExact.end())
+                matches.push_back(account->second);
+            for (Id id : mAccountGlobs)
+                if (glob(pattern(mEntries[id]), mAccount))
+                    matches.push_back(id);
+        }
+    } else {
+        matches.insert(matches.end(), mNoAccount.begin(), mNoAccount.end());
+    }
+}
+
+bool MaskSet::matches(const Subject &subject) const {
+    // Ignore lists mostly match nothing, so collecting all is not wasted
+    thread_local std::vector<Id> found;
+    found.clear();
+    match(subject, found);
+    return found.size();
+}
@@ -0,0 +1,189 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_MASKSET_HPP_
+#define UTILS_MASKSET_HPP_
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "caseMapping.hpp"
+
+// A set of nick!user@host masks, such as an ignore or ban list, that can be
+// matched against a user in one lookup. Masks use the '*' and '?' wildcards
+// and are compared under the casemapping. Partial masks are completed as an
+// ircd would: "nick" becomes "nick!*@*", "user@host" becomes "*!user@host"
+// and "host.name" becomes "*!*@host.name".
+//
+// The account extbans are understood: "$a" matches any logged in user,
+// "$~a" any user that is not, and "$a:mask", "~a:mask" or "~account:mask"
+// the users whose account matches the mask.
+//
+// Masks without wildcards are found by a hash lookup on the whole source.
+// The others are indexed on a literal fragment. Preferably that is their
+// longest one anchored in the nick, user or host: the text before the first
+// wildcard of the field, such as "spammer" of "spammer*!*@*", or after the
+// last, such as ".example.com" of "*!*@*.example.com". As nicks, users and
+// hosts never contain the '!' and '@' separators, a source can only match
+// if its field starts or ends with that fragment. A lookup hashes the start
+// and end of each field of the source for each fragment length in use, so
+// it only verifies the masks sharing one. Masks without an anchored fragment
+// of three bytes, such as "*!*@*foo*", are indexed on a trigram of their
+// text instead, and the few without any, such as "a*!*@*", are always
+// verified.
+class MaskSet {
+  public:
+    using Id = uint32_t;
+    static constexpr Id none = 0;
+
+    struct Subject {
+        std::string_view nick;
+        std::string_view user;
+        std::string_view host;
+        std::string_view account;
+    };
+
+    explicit MaskSet(const CaseMapping &caseMapping);
+
+    // Returns the id of the mask, the existing one if an equal mask has been
+    // added before, or none for a mask or extban that is not understood.
+    Id add(std::string_view mask);
+    bool remove(std::string_view mask);
+    void clear(void);
+
+    // Appends the ids of all masks matching the subject, in no particular
+    // order. Lookups share a scratch buffer, so they are not thread safe.
+    void match(const Subject &subject, std::vector<Id> &matches) const;
+    bool matches(const Subject &subject) const;
+
+    // The mask as it was added, after completion
+    std::string_view mask(Id id) const { return id < mEntries.size() ? std::string_view(mEntries[id].mask) : std::string_view(); }
+    size_t size(void) const { return mEntries.size() - 1 - mFree.size(); }
+
+    // Folds and indexes the masks again after the casemapping has been
+    // reconfigured
+    void rebuild(void);
+
+    // '*' and '?' glob match of a folded mask against a folded string
+    static bool glob(std::string_view mask, std::string_view str);
+
+  private:
+    enum class Kind : uint8_t {
+        unused,
+        exact,
+        fragment,
+        trigram,
+        residue,
+        accountExact,
+        accountGlob,
+        anyAccount,
+        noAccount,
+    };
+
+    enum Anchor : uint8_t {
+        nickPrefix,
+        nickSuffix,
+        userPrefix,
+        userSuffix,
+        hostPrefix,
+        hostSuffix,
+        anchors,
+    };
+
+    struct Entry {
+        std::string mask;
+        // The folded mask, extbans are spelled "$a", "$~a" or "$a:mask"
+        std::string key;
+        Kind kind = Kind::unused;
+        // The length of the anchored fragment, or the trigram
+        uint32_t fragment = 0;
+        Anchor anchor = nickPrefix;
+    };
+
+    const CaseMapping &mCaseMapping;
+    // A deque, so the patterns referred to by the indices do not move. The
+    // entry of none is never used.
+    std::deque<Entry> mEntries;
+    std::vector<Id> mFree;
+
+    // By key
+    std::unordered_map<std::string_view, Id> mMasks;
+    std::unordered_map<std::string_view, Id> mExact;
+    struct FragmentHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view fragment) const { return std::hash<std::string_view>()(fragment); }
+    };
+    using Fragments = std::unordered_map<std::string, std::vector<Id>, FragmentHash, std::equal_to<>>;
+    std::array<Fragments, anchors> mFragments;
+    // The number of masks indexed by each length of fragment
+    std::array<std::vector<uint32_t>, anchors> mFragmentLengths;
+    std::unordered_map<uint32_t, std::vector<Id>> mTrigrams;
+    // Set for every trigram that has a bucket, so most trigrams of a source
+    // are rejected without a hash lookup
+    std::bitset<65536> mTrigramPresent;
+    std::vector<Id> mResidue;
+    std::unordered_map<std::string_view, Id> mAccountExact;
+    std::vector<Id> mAccountGlobs;
+    std::vector<Id> mAnyAccount;
+    std::vector<Id> mNoAccount;
+
+    // Scratch space of the lookups
+    mutable std::string mSource;
+    mutable std::string mAccount;
+    mutable std::vector<uint32_t> mSeen;
+    mutable uint32_t mGeneration = 0;
+
+    static std::string complete(std::string_view mask);
+    static uint32_t trigram(const char *data) {
+        return (uint32_t)(unsigned char)data[0] << 16 | (uint32_t)(unsigned char)data[1] << 8 | (unsigned char)data[2];
+    }
+    static size_t trigramBit(uint32_t trigram) { return (trigram * 0x9E3779B1u) >> 16; }
+
+    static std::string_view pattern(const Entry &entry) {
+        return entry.kind == Kind::accountExact || entry.kind == Kind::accountGlob ? std::string_view(entry.key).substr(3)
+                                                                                  : std::string_view(entry.key);
+    }
+    bool makeKey(std::string_view mask, Entry &entry) const;
+    static void eraseFrom(std::vector<Id> &ids, Id id);
+    void index(Id id);
+    void unindex(Id id);
+    bool verify(Id id, std::string_view source) const;
+    // Splits a nick!user@host at its first '!' and the first '@' after it
+    static std::array<std::string_view, 3> fields(std::string_view source);
+    static std::string_view fragment(const Entry &entry);
+};
+
+#endif /* UTILS_MASKSET_HPP_ */
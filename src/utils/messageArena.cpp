@@ -0,0 +1,49 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "messageArena.hpp"
+
+#include <algorithm>
+
+MessageArena::MessageArena(size_t capacity)
+    : mBuffer(capacity), mResource(mBuffer.data(), mBuffer.size(), &mUpstream) {}
+
+void *MessageArena::do_allocate(size_t bytes, size_t alignment) {
+    mUsed += bytes;
+    return mResource.allocate(bytes, alignment);
+}
+
+void MessageArena::do_deallocate(void * /*p*/, size_t /*bytes*/, size_t /*alignment*/) {
+    // Memory is only reclaimed by reset()
+}
+
+void MessageArena::reset(void) {
+    mHighWaterMark = std::max(mHighWaterMark, mUsed);
+    mUsed = 0;
+    mResource.release();
+}
@@ -0,0 +1,81 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_MESSAGEARENA_HPP_
+#define UTILS_MESSAGEARENA_HPP_
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Memory resource for objects that do not outlive the processing of the
+// data received in a single read. Allocations are served from a fixed
+// buffer by bumping a pointer. When the buffer is exhausted, the arena falls
+// back to the heap. reset() releases everything at once.
+//
+// The high water mark and the number of heap fallbacks are kept, so the
+// capacity can be sized to the traffic.
+class MessageArena : public std::pmr::memory_resource {
+  public:
+    static constexpr size_t defaultCapacity = 64 * 1024;
+
+    explicit MessageArena(size_t capacity = defaultCapacity);
+
+    void reset(void);
+
+    size_t capacity(void) const { return mBuffer.size(); }
+    size_t highWaterMark(void) const { return mHighWaterMark > mUsed ? mHighWaterMark : mUsed; }
+    size_t fallbackAllocations(void) const { return mUpstream.allocations; }
+
+  private:
+    // Counts what the monotonic buffer has to request from the heap
+    struct CountingResource : public std::pmr::memory_resource {
+        size_t allocations = 0;
+
+        void *do_allocate(size_t bytes, size_t alignment) override {
+            allocations++;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+    };
+
+    std::vector<std::byte> mBuffer;
+    CountingResource mUpstream;
+    std::pmr::monotonic_buffer_resource mResource;
+    size_t mUsed = 0;
+    size_t mHighWaterMark = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+#endif /* UTILS_MESSAGEARENA_HPP_ */
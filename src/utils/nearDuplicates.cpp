@@ -0,0 +1,146 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "nearDuplicates.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+static uint64_t mix(uint64_t h) {
+    // splitmix64 finaliser
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+// Random odd multipliers and random increments
+static constexpr uint64_t multipliers[NearDuplicates::hashes] = {
+    0x9e3779b97f4a7c15, 0xbf58476d1ce4e5b9, 0x94d049bb133111eb, 0xd6e8feb86659fd93, 0xa0761d6478bd642f, 0xe7037ed1a0b428db,
+    0x8ebc6af09c88c6e3, 0x589965cc75374cc3, 0x1d8e4e27c47d124f, 0xff51afd7ed558ccd, 0xc4ceb9fe1a85ec53, 0x2127599bf4325c37,
+    0x880355f21e6d1965, 0x5851f42d4c957f2d, 0x14057b7ef767814f, 0xda942042e4dd58b5};
+static constexpr uint64_t increments[NearDuplicates::hashes] = {
+    0x243f6a8885a308d3, 0x13198a2e03707344, 0xa4093822299f31d0, 0x082efa98ec4e6c89, 0x452821e638d01377, 0xbe5466cf34e90c6c,
+    0xc0ac29b7c97c50dd, 0x3f84d5b5b5470917, 0x9216d5d98979fb1b, 0xd1310ba698dfb5ac, 0x2ffd72dbd01adfb7, 0xb8e1afed6a267e96,
+    0xba7c9045f12c7f99, 0x24a19947b3916cf7, 0x0801f2e2858efc16, 0x636920d871574e69};
+
+NearDuplicates::NearDuplicates(size_t capacity, int64_t window, double similarity)
+    : mWindow(window), mAgree(std::clamp<unsigned>(std::ceil(similarity * hashes), 1, hashes)),
+      mRecords(std::max<size_t>(capacity, 1)) {
+    for (auto &table : mBands)
+        table.assign(1u << tableBits, none);
+}
+
+NearDuplicates::Signature NearDuplicates::signature(std::string_view text) {
+    // The shingles are the runs of 4 bytes of the text with everything but
+    // letters and digits dropped and folded to lower case, so inserted
+    // punctuation, spacing and colours do not count as changes. Each
+    // position of the signature holds the minimum of another hash of them.
+    Signature result;
+    result.fill(UINT32_MAX);
+    uint32_t shingle = 0;
+    unsigned length = 0;
+    auto addShingle = [&result](uint64_t shingle) {
+        // The hashes are derived from one by multiply-shift hashing
+        uint64_t h = mix(shingle);
+        for (unsigned i = 0; i < hashes; i++)
+            result[i] = std::min(result[i], (uint32_t)((h * multipliers[i] + increments[i]) >> 32));
+    };
+    for (unsigned char c : text) {
+        if (!isalnum(c) && c < 0x80)
+            continue;
+        shingle = shingle << 8 | tolower(c);
+        if (++length >= 4)
+            addShingle(shingle);
+    }
+    if (length < 4)
+        addShingle(shingle | (uint64_t)(length + 1) << 32);
+    return result;
+}
+
+uint64_t NearDuplicates::band(const Signature &signature, unsigned band) {
+    uint64_t h = band;
+    for (unsigned row = 0; row < rows; row++)
+        h = mix(h ^ signature[band * rows + row]);
+    return h;
+}
+
+unsigned NearDuplicates::add(const Signature &signature, uint64_t source, int64_t now) {
+    // Distinct sources seen, this one first
+    std::array<uint64_t, bands * maximumLinks + 1> sources;
+    unsigned count = 0;
+    sources[count++] = source;
+
+    std::array<uint32_t, bands * maximumLinks> visited;
+    unsigned visits = 0;
+
+    std::array<uint64_t, bands> values;
+    for (unsigned b = 0; b < bands; b++) {
+        values[b] = band(signature, b);
+        uint32_t index = mBands[b][entry(values[b])];
+        int64_t previous = now;
+        for (unsigned links = 0; index != none && links < maximumLinks; links++) {
+            auto &record = mRecords[index];
+            // The chain ends at records that are too old, or that have been
+            // overwritten since they were linked
+            if (record.time <= now - mWindow || record.time > previous)
+                break;
+            uint64_t value = band(record.signature, b);
+            if (entry(value) != entry(values[b]))
+                break;
+            previous = record.time;
+
+            if (value == values[b] && std::find(visited.begin(), visited.begin() + visits, index) == visited.begin() + visits) {
+                visited[visits++] = index;
+                unsigned agree = 0;
+                for (unsigned i = 0; i < hashes; i++)
+                    agree += record.signature[i] == signature[i];
+                if (agree >= mAgree && std::find(sources.begin(), sources.begin() + count, record.source) == sources.begin() + count)
+                    sources[count++] = record.source;
+            }
+            index = record.next[b];
+        }
+    }
+
+    // Overwrite the oldest record
+    uint32_t index = mHead;
+    mHead = (mHead + 1) % mRecords.size();
+    auto &record = mRecords[index];
+    record.signature = signature;
+    record.source = source;
+    record.time = now;
+    for (unsigned b = 0; b < bands; b++) {
+        auto &head = mBands[b][entry(values[b])];
+        record.next[b] = head != index ? head : none;
+        head = index;
+    }
+    return count;
+}
@@ -0,0 +1,91 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_NEARDUPLICATES_HPP_
+#define UTILS_NEARDUPLICATES_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Finds texts that were recently sent by other sources in the same or
+// nearly the same form, such as botnet spam with a few characters changed.
+//
+// Texts are reduced to a MinHash signature: the share of positions in which
+// the signatures of two texts agree estimates how many of their shingles
+// they have in common. The signatures of recent texts are kept in a ring of
+// fixed size, the oldest is overwritten first. Similar signatures very
+// likely agree in at least one band of two positions, so every band has a
+// table linking the records that hash to the same entry, newest first. A
+// lookup follows a bounded number of links in each chain, so it costs the
+// same however many texts have been recorded.
+class NearDuplicates {
+  public:
+    static constexpr unsigned hashes = 16;
+    using Signature = std::array<uint32_t, hashes>;
+
+    // Times are in milliseconds, from any monotonic clock. Texts are near
+    // duplicates when their signatures agree in at least the given share
+    // of positions.
+    NearDuplicates(size_t capacity, int64_t window, double similarity = 0.5);
+
+    static Signature signature(std::string_view text);
+
+    // Records the signature of a text from a source, such as a host, and
+    // returns the number of distinct sources that sent a near duplicate
+    // within the window, this one included
+    unsigned add(const Signature &signature, uint64_t source, int64_t now);
+
+  private:
+    static constexpr unsigned bands = 8;
+    static constexpr unsigned rows = hashes / bands;
+    static constexpr unsigned tableBits = 16;
+    static constexpr unsigned maximumLinks = 8;
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Record {
+        Signature signature = {};
+        uint64_t source = 0;
+        int64_t time = INT64_MIN;
+        std::array<uint32_t, bands> next;
+    };
+
+    int64_t mWindow;
+    unsigned mAgree;
+    std::vector<Record> mRecords;
+    size_t mHead = 0;
+    // The newest record for each entry of each band
+    std::array<std::vector<uint32_t>, bands> mBands;
+
+    static uint64_t band(const Signature &signature, unsigned band);
+    static uint32_t entry(uint64_t band) { return band >> (64 - tableBits); }
+};
+
+#endif /* UTILS_NEARDUPLICATES_HPP_ */
@@ -0,0 +1,86 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "rateLimiter.hpp"
+
+#include <algorithm>
+#include <bit>
+
+// Key 0 marks an empty slot
+static uint64_t nonZero(uint64_t key) { return key ? key : 1; }
+
+RateLimiter::RateLimiter(size_t slots, unsigned limit, int64_t window)
+    : mLimit(std::max(limit, 1u)), mWindow(window), mMask(std::bit_ceil(std::max(slots, probes)) - 1),
+      mSlots(mMask + 1), mTimes((mMask + 1) * mLimit, INT64_MIN) {}
+
+size_t RateLimiter::find(uint64_t key) const {
+    size_t home = (key * 0x9E3779B97F4A7C15ull) >> 32;
+    for (size_t i = 0; i < probes; i++) {
+        size_t slot = (home + i) & mMask;
+        if (mSlots[slot].key == key)
+            return slot;
+    }
+    return SIZE_MAX;
+}
+
+unsigned RateLimiter::inWindow(size_t slot, int64_t now) const {
+    unsigned count = 0;
+    const int64_t *times = &mTimes[slot * mLimit];
+    for (unsigned i = 0; i < mLimit; i++)
+        count += times[i] > now - mWindow;
+    return count;
+}
+
+unsigned RateLimiter::count(uint64_t key, int64_t now) const {
+    size_t slot = find(nonZero(key));
+    return slot != SIZE_MAX ? inWindow(slot, now) : 0;
+}
+
+unsigned RateLimiter::hit(uint64_t key, int64_t now) {
+    key = nonZero(key);
+    size_t slot = find(key);
+    if (slot == SIZE_MAX) {
+        // Take the least recently active slot, an empty or expired one is
+        // the least recently active by definition
+        size_t home = (key * 0x9E3779B97F4A7C15ull) >> 32;
+        slot = home & mMask;
+        for (size_t i = 1; i < probes; i++) {
+            size_t candidate = (home + i) & mMask;
+            if (mSlots[candidate].last < mSlots[slot].last)
+                slot = candidate;
+        }
+        mSlots[slot] = {key, now, 0};
+        std::fill_n(&mTimes[slot * mLimit], mLimit, INT64_MIN);
+    }
+
+    auto &entry = mSlots[slot];
+    entry.last = now;
+    mTimes[slot * mLimit + entry.head] = now;
+    entry.head = (entry.head + 1) % mLimit;
+    return inWindow(slot, now);
+}
@@ -0,0 +1,78 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_RATELIMITER_HPP_
+#define UTILS_RATELIMITER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Counts events per key, such as a host or a channel, in a sliding window.
+// Every key has a ring holding the times of its last `limit` events, so the
+// count within the window is exact up to the limit.
+//
+// The number of keys is bounded: keys live in a fixed number of slots, and
+// a key not seen before takes a slot whose events have all left the window,
+// or else the least recently active slot of the few it may hash to. Memory
+// therefore stays the same no matter how many keys an attacker cycles
+// through, at worst the quietest keys are forgotten.
+class RateLimiter {
+  public:
+    // Times are in milliseconds, from any monotonic clock
+    RateLimiter(size_t slots, unsigned limit, int64_t window);
+
+    // Records an event for the key and returns the number of events of the
+    // key within the window, this one included, at most the limit
+    unsigned hit(uint64_t key, int64_t now);
+    // Returns the number of events within the window without recording one
+    unsigned count(uint64_t key, int64_t now) const;
+
+    unsigned limit(void) const { return mLimit; }
+    int64_t window(void) const { return mWindow; }
+
+  private:
+    struct Slot {
+        uint64_t key = 0;
+        int64_t last = INT64_MIN;
+        uint32_t head = 0;
+    };
+    static constexpr size_t probes = 8;
+
+    unsigned mLimit;
+    int64_t mWindow;
+    size_t mMask;
+    std::vector<Slot> mSlots;
+    // mLimit times for every slot
+    std::vector<int64_t> mTimes;
+
+    size_t find(uint64_t key) const;
+    unsigned inWindow(size_t slot, int64_t now) const;
+};
+
+#endif /* UTILS_RATELIMITER_HPP_ */
@@ -28,10 +28,100 @@
 
 #ifndef UTILS_SPLITSTRING_HPP_
 #define UTILS_SPLITSTRING_HPP_
+#include <cstring>
+#include <iterator>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// Splits a string into tokens, lazily, yielding views into the string.
+// It yields the same tokens as splitString() below, without allocating:
+// empty tokens between adjacent delimiters are kept, and when max_elements
+// is set, the last token holds the remainder of the string.
+//
+//     for (auto token : StringTokenizer(line, ","))
+//         ...
+//
+// The string must outlive the tokenizer and the tokens.
+class StringTokenizer {
+  public:
+    explicit StringTokenizer(std::string_view str, std::string_view delimiter = " ", const unsigned int max_elements = 0)
+        : mRemainder(str), mDelimiter(delimiter), mMaxElements(max_elements) {}
+
+    // Obtains the next token, returns false when there are no more tokens
+    bool next(std::string_view &token) {
+        if (mDone)
+            return false;
+        mCount++;
+        size_t position = std::string_view::npos;
+        if (!mMaxElements || mCount < mMaxElements)
+            position = find();
+        if (position == std::string_view::npos) {
+            token = mRemainder;
+            mDone = true;
+        } else {
+            token = mRemainder.substr(0, position);
+            mRemainder.remove_prefix(position + mDelimiter.length());
+        }
+        return true;
+    }
+
+    // The part of the string not yet returned as a token
+    std::string_view remainder(void) const { return mDone ? std::string_view() : mRemainder; }
+
+    class Iterator;
+    Iterator begin() const;
+    std::default_sentinel_t end() const { return {}; }
+
+  private:
+    std::string_view mRemainder;
+    std::string_view mDelimiter;
+    unsigned int mMaxElements;
+    unsigned int mCount = 0;
+    bool mDone = false;
+
+    size_t find(void) const {
+        // Single character delimiters, like all the ones IRC uses, take memchr
+        if (mDelimiter.length() == 1) {
+            auto found = (const char *)memchr(mRemainder.data(), mDelimiter[0], mRemainder.length());
+            return found ? found - mRemainder.data() : std::string_view::npos;
+        }
+        // An empty delimiter does not split
+        if (mDelimiter.empty())
+            return std::string_view::npos;
+        return mRemainder.find(mDelimiter);
+    }
+};
+
+class StringTokenizer::Iterator {
+  public:
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
+    explicit Iterator(const StringTokenizer &tokenizer) : mTokenizer(tokenizer) { mValid = mTokenizer.next(mToken); }
+
+    std::string_view operator*() const { return mToken; }
+    Iterator &operator++() {
+        mValid = mTokenizer.next(mToken);
+        return *this;
+    }
+    Iterator operator++(int) {
+        auto result = *this;
+        ++*this;
+        return result;
+    }
+    bool operator==(std::default_sentinel_t) const { return !mValid; }
+
+  private:
+    StringTokenizer mTokenizer{{}};
+    std::string_view mToken;
+    bool mValid = false;
+};
+
+inline StringTokenizer::Iterator StringTokenizer::begin() const { return Iterator(*this); }
+
 std::vector<std::string> splitString(const std::string &str, const std::string &delimiter = " ",
                                      const unsigned int max_elements = 0);
 
@@ -0,0 +1,110 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "symbolTable.hpp"
+
+#include "logger.hpp"
+
+SymbolTable::SymbolTable(const CaseMapping &caseMapping)
+    : mCaseMapping(caseMapping), mEntries(1), mIndex(0, caseMapping.hasher(), caseMapping.comparator()) {}
+
+SymbolTable::Symbol SymbolTable::intern(std::string_view name) {
+    auto it = mIndex.find(name);
+    if (it != mIndex.end()) {
+        mEntries[it->second].references++;
+        return it->second;
+    }
+
+    Symbol symbol;
+    if (mFree.size()) {
+        symbol = mFree.back();
+        mFree.pop_back();
+    } else {
+        symbol = Symbol(mEntries.size());
+        mEntries.emplace_back();
+    }
+    auto &entry = mEntries[symbol];
+    entry.name = name;
+    entry.references = 1;
+    mIndex.emplace(entry.name, symbol);
+    return symbol;
+}
+
+SymbolTable::Symbol SymbolTable::find(std::string_view name) const {
+    auto it = mIndex.find(name);
+    return it != mIndex.end() ? it->second : none;
+}
+
+void SymbolTable::acquire(Symbol symbol) {
+    if (symbol != none)
+        mEntries[symbol].references++;
+}
+
+void SymbolTable::release(Symbol symbol) {
+    if (symbol == none)
+        return;
+    auto &entry = mEntries[symbol];
+    if (!entry.references) {
+        LOG_ERROR("Releasing unreferenced symbol %u", symbol);
+        return;
+    }
+    if (--entry.references)
+        return;
+
+    auto it = mIndex.find(entry.name);
+    if (it != mIndex.end() && it->second == symbol)
+        mIndex.erase(it);
+    // Give the memory back, the entry may stay unused for a long time
+    std::string().swap(entry.name);
+    mFree.push_back(symbol);
+}
+
+bool SymbolTable::rename(Symbol symbol, std::string_view name) {
+    if (symbol == none)
+        return false;
+    auto other = mIndex.find(name);
+    if (other != mIndex.end() && other->second != symbol)
+        return false;
+
+    auto &entry = mEntries[symbol];
+    auto it = mIndex.find(entry.name);
+    if (it != mIndex.end() && it->second == symbol)
+        mIndex.erase(it);
+    entry.name = name;
+    mIndex.emplace(entry.name, symbol);
+    return true;
+}
+
+void SymbolTable::rehash(void) {
+    decltype(mIndex) index(mIndex.size(), mCaseMapping.hasher(), mCaseMapping.comparator());
+    for (Symbol symbol = 1; symbol < mEntries.size(); symbol++) {
+        if (mEntries[symbol].references)
+            index.emplace(mEntries[symbol].name, symbol);
+    }
+    mIndex.swap(index);
+}
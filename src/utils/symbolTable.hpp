@@ -0,0 +1,86 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_SYMBOLTABLE_HPP_
+#define UTILS_SYMBOLTABLE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "caseMapping.hpp"
+
+// Interns identifiers such as nicks, channels and hosts into dense 32 bit
+// symbols. Names that are equal under the casemapping share a symbol, the
+// spelling it was first interned with is kept. Every intern() or acquire()
+// takes a reference and has to be balanced by a release(). A symbol without
+// references is freed and its number is reused.
+class SymbolTable {
+  public:
+    using Symbol = uint32_t;
+    static constexpr Symbol none = 0;
+
+    explicit SymbolTable(const CaseMapping &caseMapping);
+
+    Symbol intern(std::string_view name);
+    // Looks up a name without taking a reference, none when it is unknown
+    Symbol find(std::string_view name) const;
+
+    void acquire(Symbol symbol);
+    void release(Symbol symbol);
+
+    std::string_view name(Symbol symbol) const { return symbol != none ? mEntries[symbol].name : std::string_view(); }
+    // Changes the spelling of a symbol, for instance when a nick changes
+    // case. Returns false if the new name already belongs to another one.
+    bool rename(Symbol symbol, std::string_view name);
+
+    // Rebuilds the index after the casemapping has been reconfigured.
+    // Should two names now be equal, lookups find the first of them.
+    void rehash(void);
+
+    size_t size(void) const { return mIndex.size(); }
+
+  private:
+    struct Entry {
+        std::string name;
+        uint32_t references = 0;
+    };
+
+    const CaseMapping &mCaseMapping;
+    // A deque, so the names referred to by the index do not move. The
+    // entry of none is never used.
+    std::deque<Entry> mEntries;
+    std::vector<Symbol> mFree;
+    std::unordered_map<std::string_view, Symbol, CaseMapping::Hash, CaseMapping::Equal> mIndex;
+};
+
+#endif /* UTILS_SYMBOLTABLE_HPP_ */
@@ -29,22 +29,37 @@
 #include "timer.hpp"
 
 void Timer::theadCode(void) {
-    std::mutex mtx;
     std::unique_lock<std::mutex> lck(mtx);
-    if (cv.wait_for(lck, timeout) == std::cv_status::timeout) {
-        if (cb)
-            cb();
+    // The flag catches an abort issued before this thread started waiting
+    if (!cv.wait_for(lck, timeout, [this]() { return aborted; })) {
+        // A copy, the callback may arm the timer again
+        auto callback = cb;
+        lck.unlock();
+        if (callback)
+            callback();
     }
 }
 
-void Timer::afterSeconds(callBack cb, std::chrono::seconds timeout) {
+void Timer::afterSeconds(callBack cb, std::chrono::seconds timeout) { afterMilliseconds(cb, timeout); }
+
+void Timer::afterMilliseconds(callBack cb, std::chrono::milliseconds timeout) {
     abortTimer();
     this->cb = cb;
     this->timeout = timeout;
+    aborted = false;
     thread = std::thread([this]() { theadCode(); });
 }
 void Timer::abortTimer(void) {
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        aborted = true;
+    }
     cv.notify_all();
-    if (thread.joinable())
-        thread.join();
+    if (thread.joinable()) {
+        // From the callback, the thread ends when it returns
+        if (thread.get_id() == std::this_thread::get_id())
+            thread.detach();
+        else
+            thread.join();
+    }
 }
@@ -32,19 +32,25 @@
 #include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <mutex>
 #include <thread>
 
 class Timer {
   public:
     using callBack = std::function<void()>;
+    // Calls back on a thread of its own. Arming the timer again, also from
+    // within the callback, replaces what was pending.
     void afterSeconds(callBack cb, std::chrono::seconds timeout);
+    void afterMilliseconds(callBack cb, std::chrono::milliseconds timeout);
     void abortTimer(void);
 
   private:
     callBack cb = nullptr;
     std::thread thread;
     std::condition_variable cv;
-    std::chrono::seconds timeout;
+    std::mutex mtx;
+    bool aborted = false;
+    std::chrono::milliseconds timeout;
     void theadCode(void);
 };
 
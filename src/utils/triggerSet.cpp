@@ -0,0 +1,194 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#include "triggerSet.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+static bool isWordByte(char c) {
+    // Bytes of UTF-8 sequences count as letters
+    return isalnum((unsigned char)c) || c == '_' || (unsigned char)c >= 0x80;
+}
+
+TriggerSet::TriggerSet() {}
+
+TriggerSet::~TriggerSet() {}
+
+TriggerSet::Id TriggerSet::addKeyword(std::string_view keyword, bool wholeWord) {
+    if (keyword.empty())
+        return none;
+    mKeywordIds.push_back(mTriggers.size());
+    mTriggers.push_back({false, wholeWord, mKeywords.add(keyword)});
+    mCompiled = false;
+    return mTriggers.size() - 1;
+}
+
+TriggerSet::Id TriggerSet::addRegex([[maybe_unused]] std::string_view regex, std::string *error) {
+#ifdef ENABLE_RE2
+    RE2::Options options;
+    options.set_log_errors(false);
+    auto compiled = std::make_unique<RE2>(re2::StringPiece(regex.data(), regex.length()), options);
+    if (!compiled->ok()) {
+        if (error)
+            *error = compiled->error();
+        return none;
+    }
+    mRegexIds.push_back(mTriggers.size());
+    mTriggers.push_back({true, false, (uint32_t)mRegexes.size()});
+    mRegexes.push_back(std::move(compiled));
+    mCompiled = false;
+    return mTriggers.size() - 1;
+#else
+    if (error)
+        *error = "Regular expressions have been disabled";
+    return none;
+#endif
+}
+
+void TriggerSet::remove(Id id) {
+    if (id >= mTriggers.size() || mTriggers[id].removed)
+        return;
+    mTriggers[id].removed = true;
+    mRemoved++;
+    mPrune = true;
+    mCompiled = false;
+}
+
+void TriggerSet::clear(void) {
+    mTriggers.clear();
+    mRemoved = 0;
+    mPrune = false;
+    mKeywords.clear();
+    mKeywordIds.clear();
+#ifdef ENABLE_RE2
+    mRegexes.clear();
+    mRegexIds.clear();
+    mRegexSet.reset();
+#endif
+    mSeen.clear();
+    mCompiled = true;
+}
+
+void TriggerSet::prune(void) {
+    AhoCorasick keywords;
+    std::vector<Id> keywordIds;
+    for (Id id : mKeywordIds) {
+        auto &trigger = mTriggers[id];
+        if (trigger.removed)
+            continue;
+        keywordIds.push_back(id);
+        trigger.index = keywords.add(mKeywords.pattern(trigger.index));
+    }
+    mKeywords = std::move(keywords);
+    mKeywordIds = std::move(keywordIds);
+#ifdef ENABLE_RE2
+    std::vector<std::unique_ptr<RE2>> regexes;
+    std::vector<Id> regexIds;
+    for (Id id : mRegexIds) {
+        auto &trigger = mTriggers[id];
+        if (trigger.removed)
+            continue;
+        regexIds.push_back(id);
+        regexes.push_back(std::move(mRegexes[trigger.index]));
+        trigger.index = regexes.size() - 1;
+    }
+    mRegexes = std::move(regexes);
+    mRegexIds = std::move(regexIds);
+#endif
+    mPrune = false;
+}
+
+void TriggerSet::compile(void) {
+    if (mPrune)
+        prune();
+    mKeywords.build();
+#ifdef ENABLE_RE2
+    mRegexSet.reset();
+    if (mRegexes.size()) {
+        RE2::Options options;
+        options.set_log_errors(false);
+        mRegexSet = std::make_unique<RE2::Set>(options, RE2::UNANCHORED);
+        // Every expression compiled on its own, so it compiles in the set
+        for (auto &regex : mRegexes)
+            mRegexSet->Add(regex->pattern(), nullptr);
+        if (!mRegexSet->Compile())
+            // Out of memory, fall back to running them one by one
+            mRegexSet.reset();
+    }
+#endif
+    mSeen.assign(mTriggers.size(), 0);
+    mGeneration = 0;
+    mCompiled = true;
+}
+
+void TriggerSet::scan(std::string_view text, std::vector<std::pair<Id, std::string_view>> &matches) {
+    if (!mCompiled)
+        compile();
+    if (!++mGeneration) {
+        std::fill(mSeen.begin(), mSeen.end(), 0);
+        mGeneration = 1;
+    }
+    size_t first = matches.size();
+
+    mKeywords.scan(text, [this, text, &matches](AhoCorasick::Pattern pattern, size_t end) {
+        Id id = mKeywordIds[pattern];
+        if (mSeen[id] == mGeneration)
+            return true;
+        size_t begin = end - mKeywords.pattern(pattern).length();
+        if (mTriggers[id].wholeWord &&
+            ((begin > 0 && isWordByte(text[begin - 1])) || (end < text.length() && isWordByte(text[end]))))
+            return true;
+        mSeen[id] = mGeneration;
+        matches.emplace_back(id, text.substr(begin, end - begin));
+        return true;
+    });
+
+#ifdef ENABLE_RE2
+    if (mRegexes.size()) {
+        re2::StringPiece input(text.data(), text.length());
+        re2::StringPiece match;
+        auto found = [&](int index) {
+            if (mRegexes[index]->Match(input, 0, input.length(), RE2::UNANCHORED, &match, 1))
+                matches.emplace_back(mRegexIds[index], std::string_view(match.data(), match.length()));
+        };
+        if (mRegexSet) {
+            // Asking which ones matched allocates, most texts match none
+            mRegexMatches.clear();
+            if (mRegexSet->Match(input, nullptr) && mRegexSet->Match(input, &mRegexMatches))
+                for (int index : mRegexMatches)
+                    found(index);
+        } else {
+            for (size_t index = 0; index < mRegexes.size(); index++)
+                found(index);
+        }
+    }
+#endif
+
+    std::sort(matches.begin() + first, matches.end(), [](auto &a, auto &b) { return a.first < b.first; });
+}
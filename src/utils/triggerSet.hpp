@@ -0,0 +1,112 @@
+/*
+
+ Author:	André van Schoubroeck <andre@blaatschaap.be>
+ License:	MIT
+
+ SPDX-License-Identifier: MIT
+
+ Copyright (c) 2025 André van Schoubroeck <andre@blaatschaap.be>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ */
+
+#ifndef UTILS_TRIGGERSET_HPP_
+#define UTILS_TRIGGERSET_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ahoCorasick.hpp"
+
+#ifdef ENABLE_RE2
+#include <re2/re2.h>
+#include <re2/set.h>
+#endif
+
+// Keyword and regular expression triggers, matched against a text in one
+// scan regardless of how many there are. Keywords are compiled into a
+// single case insensitive Aho-Corasick automaton, regular expressions into
+// a single RE2::Set. Only the expressions the set reports as matching are
+// run on their own, to find the text they matched.
+//
+// Adding and removing triggers is cheap, the automaton and set are compiled
+// again on the first scan after a change.
+class TriggerSet {
+  public:
+    using Id = uint32_t;
+    static constexpr Id none = UINT32_MAX;
+
+    TriggerSet();
+    ~TriggerSet();
+
+    // A whole word keyword only matches when not directly preceded or
+    // followed by a letter, digit or underscore
+    Id addKeyword(std::string_view keyword, bool wholeWord = false);
+    // Returns none for an expression that does not compile, or when support
+    // for regular expressions has been disabled
+    Id addRegex(std::string_view regex, std::string *error = nullptr);
+    // The ids of the other triggers stay the same
+    void remove(Id id);
+    void clear(void);
+
+    size_t size(void) const { return mTriggers.size() - mRemoved; }
+
+    // Appends every trigger matching the text, with the first text it
+    // matched, in the order of their ids
+    void scan(std::string_view text, std::vector<std::pair<Id, std::string_view>> &matches);
+
+  private:
+    struct Trigger {
+        bool regex;
+        bool wholeWord;
+        // The keyword pattern or the index in the regex set
+        uint32_t index;
+        bool removed = false;
+    };
+    std::vector<Trigger> mTriggers;
+    size_t mRemoved = 0;
+    // Removed triggers are still in the automaton or set
+    bool mPrune = false;
+
+    AhoCorasick mKeywords;
+    // By keyword pattern
+    std::vector<Id> mKeywordIds;
+
+#ifdef ENABLE_RE2
+    std::vector<std::unique_ptr<RE2>> mRegexes;
+    std::vector<Id> mRegexIds;
+    std::unique_ptr<RE2::Set> mRegexSet;
+    std::vector<int> mRegexMatches;
+#endif
+    bool mCompiled = true;
+
+    // Stamped with the generation of the scan a keyword trigger matched in
+    std::vector<uint32_t> mSeen;
+    uint32_t mGeneration = 0;
+
+    void prune(void);
+    void compile(void);
+};
+
+#endif /* UTILS_TRIGGERSET_HPP_ */